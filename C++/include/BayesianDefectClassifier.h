@@ -2,25 +2,71 @@
 #define BAYESIANDEFECTCLASSIFIER_H
 
 #include "ImageTextureFeatures.h"
+#include "BoardTextureScanner.h"
+#include "FeatureVector.h"
+#include "GaussianModel.h"
+#include "IntegralStatistics.h"
+#include "ModelFile.h"
 #include <vector>
 #include <map>
 #include <string>
 #include <iostream>
 #include <memory>
 #include <cmath>
+#include <array>
 
-// Class definition for BayesianDefectClassifier
+// Gaussian statistics of one defect class, computed once by BayesianDefectClassifier::train()
+struct DefectClassModel
+{
+    std::string name;                 // Defect class name (regionName of its samples)
+    int sampleCount = 0;              // Number of training samples of the class
+    FeatureVector mean;               // Mean feature vector
+    std::array<double, kFeatureCount * kFeatureCount> covariance{};  // Row-major feature covariance
+};
+
+// Feature subset selected for one pair of defect classes
+struct ClassPairModel
+{
+    int classI = 0;                   // Index of the first class in classModels
+    int classJ = 0;                   // Index of the second class in classModels
+    std::vector<int> selectedFeatures;  // Feature indices in FeatureVector order
+    GaussianModel modelI;             // Likelihood of the first class over selectedFeatures
+    GaussianModel modelJ;             // Likelihood of the second class over selectedFeatures
+};
+
+// First stage of the clear-wood cascade: a distance on the four statistical features, which are known
+// before any co-occurrence matrix is built. Calibrated by BayesianDefectClassifier::calibrateClearCascade().
+struct ClearWoodCascade
+{
+    bool enabled = false;             // Set once calibrated; otherwise no patch passes the first stage
+    StatisticalFeatures center{};     // Mean statistical features of the clear-wood samples
+    StatisticalFeatures scale{};      // Per-feature variance over all training samples
+    double threshold = 0.0;           // Largest normalized distance still accepted as clear wood
+    double recall = 0.0;              // Fraction of clear-wood training samples accepted by threshold
+};
+
+// Class definition for BayesianDefectClassifier.
+// train() builds the model once from defects; classification is then a read-only call against it.
+// Classification runs on FeatureVector; the std::map overloads are adapters for string-keyed callers.
 class BayesianDefectClassifier
 {
 public:
-    // Vector of shared pointers to ImageTextureFeatures objects representing defects
+    // Vector of shared pointers to ImageTextureFeatures objects representing defects. Reading their texture
+    // features computes them lazily, so train() reads them from one thread and workers never touch them.
     std::vector<std::shared_ptr<ImageTextureFeatures>> defects;
 
-    // Map representing the reference features for clear wood
-    std::map<std::string, double> clearWoodReference;
+    // Reference features for clear wood, valid when hasClearWoodReference is set
+    FeatureVector clearWoodReference;
+    bool hasClearWoodReference = false;
+
+    // Features of every clear-wood sample, used to calibrate the cascade
+    std::vector<FeatureVector> clearWoodSamples;
 
-    // Vector of maps, each representing the features of different defect datasets
-    std::vector<std::map<std::string, double>> defectDatasets;
+    // Cheap first stage that rejects clear wood before texture features are computed
+    ClearWoodCascade clearCascade;
+
+    // Features of the different defect datasets, one contiguous row per dataset
+    std::vector<FeatureVector> defectDatasets;
 
     // Vector of strings representing different defect classes
     std::vector<std::string> defectClasses;
@@ -28,24 +74,104 @@ public:
     // Vector of strings representing the feature set used for classification
     std::vector<std::string> featureSet;
 
-    // Constructor: Initializes the feature set
-    BayesianDefectClassifier(const std::vector<std::string>& FeatureSet)
-        : featureSet{ FeatureSet } {
-    }
+    // Indices of featureSet in FeatureVector order
+    std::vector<int> featureIndices;
+
+    // Trained model: per-class statistics and per-pair feature subsets
+    std::array<double, kFeatureCount * kFeatureCount> pooledCovariance{};  // Covariance of all defect samples
+    FeatureVector featureRidge;       // Diagonal regularization added to every class covariance
+    std::vector<DefectClassModel> classModels;
+    std::vector<ClassPairModel> pairModels;
+    bool trained = false;
 
-    // Fills the defect datasets and classes based on the given distance and angle
+    // Model file the model was loaded from, if any; its feature store is read in place
+    std::shared_ptr<const ModelFile> modelFile;
+
+    // Constructor: Initializes the feature set and resolves its feature indices
+    BayesianDefectClassifier(const std::vector<std::string>& FeatureSet);
+
+    // Fills the defect datasets and classes based on the given distance and angle (replacing previous contents)
     void fillDefectDatasetsAndDefectClasses(double distance, double angle);
 
-    // Performs forward sequential search to find the best feature subset
+    // Builds the model from defects: class statistics and the feature subset of every class pair.
+    // Call again after changing defects; this replaces a loaded model.
+    void train();
+    void train(WorkStealingPool& pool);
+
+    // Writes the trained model to a binary model file (see ModelFile.h), together with the extraction settings
+    // of its samples and, when includeFeatureStore is set, the samples themselves as a feature store.
+    // Returns false if untrained or on I/O errors.
+    bool saveModel(const std::string& path, const ExtractionSettings& settings, bool includeFeatureStore = true) const;
+
+    // Loads a model written by saveModel() in place of training, and the extraction settings to use with it.
+    // The GaussianModels are refactorized from the stored statistics; the feature store stays in the mapped
+    // file and is reached through modelFile.
+    bool loadModel(const std::string& path, ExtractionSettings& settings);
+
+    // Performs forward sequential search to find the best feature subset (indices in FeatureVector order).
+    // The two samples are compared under the pooled training covariance, where the Bhattacharyya
+    // criterion reduces to their Mahalanobis distance.
+    // Needs the trained pooled covariance, so an untrained classifier is trained first (like classifyLumberDefect()).
+    std::vector<int> forwardSequentialSearch(const FeatureVector& defect_i, const FeatureVector& defect_j);
     std::vector<std::string> forwardSequentialSearch(
         const std::map<std::string, double>& defect_i,
         const std::map<std::string, double>& defect_j);
 
-    // Classifies the lumber defect based on the given region features
+    // Returns the index in classModels of the most likely class, or -1 without classes.
+    // voteShare, when given, receives the fraction of its pairwise contests the winner won (1 with one class).
+    // Read-only and allocation-free in steady state; requires a trained model.
+    int predictClassIndex(const FeatureVector& regionFeatures, double* voteShare = nullptr) const;
+
+    // Batch version of predictClassIndex(): scores all regions against each class pair at once and writes
+    // count class indices. Gives the same indices as predictClassIndex() region by region; read-only and
+    // allocation-free in steady state.
+    void predictClassIndices(const FeatureVector* regions, size_t count, int* classIndices) const;
+    void predictClassIndices(const std::vector<FeatureVector>& regions, std::vector<int>& classIndices) const;
+
+    // Classifies the lumber defect based on the given region features (trains first if needed)
+    std::string classifyLumberDefect(const FeatureVector& regionFeatures);
     std::string classifyLumberDefect(const std::map<std::string, double>& regionFeatures);
 
+    // Classifies many feature vectors in parallel (trains on the pool first if needed); labels are returned in input order
+    std::vector<std::string> classifyBatch(const std::vector<FeatureVector>& regions, WorkStealingPool& pool);
+
+    // Extracts features from image tiles and classifies them in parallel; labels are returned in input order
+    std::vector<std::string> classifyBatch(const std::vector<cv::Mat>& tiles, const ExtractionSettings& settings, WorkStealingPool& pool);
+
+    // Classifies the regions of interest of one image in parallel; labels are returned in input order
+    std::vector<std::string> classifyRegions(const cv::Mat& image, const std::vector<cv::Rect>& rois,
+        const ExtractionSettings& settings, WorkStealingPool& pool);
+
+    // Classifies every window of a feature map produced by BoardTextureScanner, in row-major order
+    std::vector<std::string> classifyFeatureMap(const cv::Mat& featureMap);
+
+    // Calibrates the first stage of the clear-wood cascade so that it accepts targetRecall of the clear-wood
+    // samples while accepting none of the defect samples (trains first if needed). Returns false, leaving
+    // the cascade unchanged, without clear-wood samples.
+    bool calibrateClearCascade(double targetRecall = 0.95);
+
+    // Normalized distance of the statistical features to the clear-wood center of the cascade
+    double clearCascadeDistance(const StatisticalFeatures& stats) const;
+
+    // True when the first stage of the cascade accepts the patch as clear wood
+    bool passesClearCascade(const StatisticalFeatures& stats) const;
+
+    // Classifies a patch through the cascade: clear wood accepted by the first stage is labelled
+    // "Clear area" without computing texture features; everything else goes through the full classifier.
+    std::string classifyPatch(const ImageTextureFeatures& patch);
+
     // Checks if the test region of interest (ROI) is a clear area based on the given threshold
-    bool isClearArea(const std::map<std::string, double>& testROI, double thresh);
+    bool isClearArea(const FeatureVector& testROI, double thresh) const;
+    bool isClearArea(const std::map<std::string, double>& testROI, double thresh) const;
+
+    // Checks many candidate boxes of one board with features read from its integral statistics.
+    // The clear-wood reference must use the gray levels of the integral co-occurrence table.
+    std::vector<bool> screenClearAreas(const IntegralStatistics& integral, const std::vector<cv::Rect>& boxes, double thresh) const;
+
+private:
+    // Greedy forward selection maximizing the Bhattacharyya distance of two Gaussians (means and row-major covariances)
+    std::vector<int> selectFeatures(const FeatureVector& mean_i, const double* covariance_i,
+        const FeatureVector& mean_j, const double* covariance_j) const;
 };
 
 #endif // BAYESIANDEFECTCLASSIFIER_H
@@ -0,0 +1,60 @@
+#ifndef BOARDTEXTURESCANNER_H
+#define BOARDTEXTURESCANNER_H
+
+#include <opencv2/core.hpp>
+#include <map>
+#include <string>
+#include <vector>
+#include "CooccurrenceStatistics.h"
+#include "IntensityStatistics.h"
+#include "GrayLevelQuantizer.h"
+#include "FeatureVector.h"
+
+// Slides a fixed-size window across a whole board image and produces a dense map of texture features.
+// The pair histogram and the intensity power sums are updated incrementally: moving the window by one
+// row or column removes the pairs of the leaving line and adds those of the entering line, so the cost
+// per window is proportional to the window height (or width), not to its area.
+class BoardTextureScanner {
+private:
+    cv::Mat board;                  // Whole grayscale board image (CV_8UC1)
+    GrayLevelQuantizer quantizer;   // Maps gray values onto the levels of the pair histogram
+    cv::Mat levelImage;             // Board in quantized levels, used for the pair histogram
+    int windowRows;                 // Window height in pixels
+    int windowCols;                 // Window width in pixels
+    int stride;                     // Step between consecutive windows, in pixels
+    int dx;                         // Row displacement of the co-occurrence offset
+    int dy;                         // Column displacement of the co-occurrence offset
+
+    int top;                        // Row of the current window origin
+    int left;                       // Column of the current window origin
+    cv::Mat cooccurrenceFreq;       // Pair counts of the current window (levels x levels, CV_32S)
+    CooccurrenceSums cooccurrenceSums;  // Running sums over cooccurrenceFreq
+
+    IntensitySums intensitySums;    // Running power sums of the pixel values in the current window
+
+    void resetWindow();                          // Builds the histogram of the window at the origin from scratch
+    void updatePair(int i, int j, int sign);     // Adds (+1) or removes (-1) one pixel pair from the histogram
+    void updateRow(int row, int sign);           // Adds or removes the pixels and pairs of one window row
+    void updateColumn(int col, int sign);        // Adds or removes the pixels and pairs of one window column
+    void moveRight();                            // Slides the window one column to the right
+    void moveLeft();                             // Slides the window one column to the left
+    void moveDown();                             // Slides the window one row down
+    void writeFeatures(double* out) const;       // Writes the features of the current window in FeatureVector order
+
+public:
+    // Constructor: Sets up the scan of Board with the given window size, stride, angle, distance and gray-level quantization
+    BoardTextureScanner(const cv::Mat& Board, int WindowRows, int WindowCols, int Stride, double Angle, double Distance,
+        int Levels = 256, QuantizationMode Mode = QuantizationMode::Uniform);
+
+    // Scans the whole board; returns a CV_64FC(kFeatureCount) map with one FeatureVector per window position.
+    // Element (r, c) describes the window whose origin is (r * stride, c * stride).
+    cv::Mat scan();
+
+    // Returns the features of one window of a feature map
+    static FeatureVector windowFeatureVector(const cv::Mat& featureMap, int row, int col);
+
+    // Returns the features of one window of a feature map, keyed by feature name
+    static std::map<std::string, double> windowFeatures(const cv::Mat& featureMap, int row, int col);
+};
+
+#endif // BOARDTEXTURESCANNER_H
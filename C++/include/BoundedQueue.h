@@ -0,0 +1,95 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Lock-free single-producer/single-consumer ring buffer with a fixed capacity.
+// push() waits while the queue is full, which propagates backpressure to the producing stage
+// instead of buffering without bound; pop() waits while it is empty and not closed.
+template <typename T>
+class BoundedQueue
+{
+private:
+    std::vector<T> slots;                         // Ring storage, size is a power of two
+    size_t mask;                                  // slots.size() - 1
+    alignas(64) std::atomic<size_t> head{ 0 };    // Next slot to pop (owned by the consumer)
+    alignas(64) std::atomic<size_t> tail{ 0 };    // Next slot to push (owned by the producer)
+    alignas(64) std::atomic<bool> closed{ false };
+
+    // Spins briefly, then yields, then sleeps, so idle stages do not burn a core
+    static void backoff(int& attempt) {
+        ++attempt;
+        if (attempt < 64) {
+            return;
+        }
+        if (attempt < 256) {
+            std::this_thread::yield();
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+public:
+    // Constructor: Rounds Capacity up to a power of two
+    explicit BoundedQueue(size_t Capacity) {
+        size_t size = 1;
+        while (size < Capacity) {
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    // Adds an item if there is room; returns false when the queue is full
+    bool tryPush(T& item) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) {
+            return false;
+        }
+        slots[t & mask] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Removes the oldest item if there is one; returns false when the queue is empty
+    bool tryPop(T& item) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Adds an item, waiting for room
+    void push(T item) {
+        int attempt = 0;
+        while (!tryPush(item)) {
+            backoff(attempt);
+        }
+    }
+
+    // Removes the oldest item, waiting for one; returns false once the queue is closed and drained
+    bool pop(T& item) {
+        int attempt = 0;
+        while (!tryPop(item)) {
+            if (closed.load(std::memory_order_acquire)) {
+                return tryPop(item);  // Items pushed before close() are still delivered
+            }
+            backoff(attempt);
+        }
+        return true;
+    }
+
+    // Marks the end of the stream; called by the producer after its last push
+    void close() { closed.store(true, std::memory_order_release); }
+};
+
+#endif // BOUNDEDQUEUE_H
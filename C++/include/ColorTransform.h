@@ -0,0 +1,19 @@
+#ifndef COLORTRANSFORM_H
+#define COLORTRANSFORM_H
+
+#include <opencv2/core.hpp>
+
+// How a multi-channel image is reduced to the single channel the texture features are computed on
+enum class ColorTransform {
+    Luma,      // Weighted sum 0.114 B + 0.587 G + 0.299 R (BGR channel order, as OpenCV loads images)
+    Average,   // Mean of all channels
+    Channel    // One channel, selected by index
+};
+
+// Reduces a 1-, 3- or 4-channel 8-bit, 16-bit or float image to one channel of the same depth.
+// A single-channel image is returned as is. Otherwise dst keeps its buffer when it already has the size and
+// type of the result, so it must not be a view of an image that is still needed. Returns false, with dst
+// empty, for unsupported input.
+bool applyColorTransform(const cv::Mat& src, ColorTransform transform, int channel, cv::Mat& dst);
+
+#endif // COLORTRANSFORM_H
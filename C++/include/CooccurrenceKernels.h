@@ -0,0 +1,17 @@
+#ifndef COOCCURRENCEKERNELS_H
+#define COOCCURRENCEKERNELS_H
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <vector>
+
+// Adds the pair counts of offset (dx, dy) over an 8-bit level image (every value < levels) to freq,
+// a row-major levels x levels CV_32S buffer, and appends to cells the flat index of every cell the call
+// turns from zero to non-zero. Starting from a zeroed freq, cells then lists its non-zero cells without a
+// scan of the matrix or the image. Returns the number of pairs added.
+// Only the region where both pixels are in bounds is visited, so the inner loop has no bounds checks;
+// increments are spread over several private histograms (reduced at the end) to avoid
+// store-to-load stalls on runs of equal gray levels. Uses AVX2 or NEON when available.
+int64_t accumulateCooccurrence(const cv::Mat& levelImage, int levels, int dx, int dy, int32_t* freq, std::vector<int>& cells);
+
+#endif // COOCCURRENCEKERNELS_H
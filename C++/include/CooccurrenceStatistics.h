@@ -0,0 +1,97 @@
+#ifndef COOCCURRENCESTATISTICS_H
+#define COOCCURRENCESTATISTICS_H
+
+#include <cstdint>  // Fixed-width integers for the exact running sums
+#include <cmath>
+#include <vector>
+
+// Angle (degrees) and distance (pixels) between the reference and neighbor pixel of a co-occurrence pair
+struct CooccurrenceOffset {
+    double angle = 0.0;
+    double distance = 1.0;
+
+    // Row displacement of the neighbor pixel
+    int rowShift() const { return static_cast<int>(std::round(distance * std::cos(radians()))); }
+    // Column displacement of the neighbor pixel
+    int colShift() const { return static_cast<int>(std::round(distance * std::sin(radians()))); }
+
+private:
+    float radians() const { return static_cast<float>(angle * 3.14159265358979323846 / 180.0f); }
+};
+
+// Haralick texture features derived from a normalized co-occurrence matrix
+struct HaralickFeatures {
+    double mx1 = 0.0;                // First moment: mean gray level of the reference pixel
+    double mx2 = 0.0;                // Second moment: mean gray level of the neighbor pixel
+    double clusterShade = 0.0;
+    double clusterProminence = 0.0;
+    double localHomogeneity = 0.0;
+    double energy = 0.0;
+    double entropy = 0.0;
+    double inertia = 0.0;
+};
+
+// Groups of CooccurrenceSums that can be gathered separately: the integer power sums every feature needs,
+// the homogeneity sum (a division per cell) and the entropy sum (a logarithm per cell)
+enum CooccurrenceSumGroup : unsigned {
+    kPowerSums = 1u,
+    kHomogeneitySum = 2u,
+    kEntropySum = 4u,
+    kAllSums = 7u
+};
+
+// Integer type of the fourth-power sum. (i + j)^4 reaches 510^4 ~ 6.8e10 at 256 levels, so an int64_t sum
+// overflows past ~1.4e8 pairs (a 12k x 12k board of bright pixels), and a single cell's term past the same
+// count. 128 bits keep the sum exact, and so order-independent, for any histogram of int32_t counts.
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef __int128 FourthPowerSum;  // __extension__: a GNU type, no -Wpedantic warning
+#else
+using FourthPowerSum = long double;  // No 128-bit integer: exact only while the sum fits the mantissa
+#endif
+
+// Running sums over the cells of a co-occurrence histogram.
+// Every Haralick feature is a closed-form function of these sums, so a histogram is traversed once
+// (visiting only its non-zero cells), and a histogram that changes cell by cell can keep them up to date in O(1).
+struct CooccurrenceSums {
+    int64_t pairs = 0;            // Number of pixel pairs, sum of c
+    int64_t sumI = 0;             // Sum of i * c
+    int64_t sumJ = 0;             // Sum of j * c
+    int64_t sumS2 = 0;            // Sum of (i + j)^2 * c
+    int64_t sumS3 = 0;            // Sum of (i + j)^3 * c
+    FourthPowerSum sumS4 = 0;     // Sum of (i + j)^4 * c
+    int64_t sumD2 = 0;            // Sum of (i - j)^2 * c
+    int64_t sumC2 = 0;            // Sum of c^2
+    double sumHomogeneity = 0.0;  // Sum of c / (1 + (i - j)^2)
+    double sumCLogC = 0.0;        // Sum of c * log2(c)
+
+    // Accounts for cell (i, j) changing its count from oldCount to newCount
+    void updateCell(int i, int j, int64_t oldCount, int64_t newCount) {
+        const int64_t delta = newCount - oldCount;
+        const int64_t s = i + j;
+        const int64_t d2 = static_cast<int64_t>(i - j) * (i - j);
+        pairs += delta;
+        sumI += i * delta;
+        sumJ += j * delta;
+        sumS2 += s * s * delta;
+        sumS3 += s * s * s * delta;
+        sumS4 += static_cast<FourthPowerSum>(s * s * s * s) * delta;
+        sumD2 += d2 * delta;
+        sumC2 += newCount * newCount - oldCount * oldCount;
+        sumHomogeneity += static_cast<double>(delta) / (1 + d2);
+        sumCLogC += cLogC(newCount) - cLogC(oldCount);
+    }
+
+    // Adds a cell (i, j) holding count c to the sums
+    void addCell(int i, int j, int64_t count) { updateCell(i, j, 0, count); }
+
+    // Adds the listed cells of a levels x levels histogram to the sums of the given CooccurrenceSumGroup bits only
+    void addCells(const int32_t* freq, const std::vector<int>& cells, int levels, unsigned groups);
+
+    // Converts the sums into the Haralick features of the normalized matrix p = c / pairs
+    HaralickFeatures toFeatures() const;
+
+private:
+    static double cLogC(int64_t c) { return c > 1 ? c * std::log2(static_cast<double>(c)) : 0.0; }
+};
+
+#endif // COOCCURRENCESTATISTICS_H
@@ -0,0 +1,79 @@
+#ifndef DEFECTLOCALIZER_H
+#define DEFECTLOCALIZER_H
+
+#include "BayesianDefectClassifier.h"
+#include "WorkStealingPool.h"
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+// Cell labels of a DefectMap besides the class indices of the classifier
+const int kClearLabel = -1;            // Clear wood
+const int kUnclassifiedLabel = -2;     // Board margin too small for a tile
+
+// Settings of coarse-to-fine defect localization
+struct LocalizationSettings {
+    ExtractionSettings extraction;     // Texture feature extraction parameters
+    int tileSize = 64;                 // Edge length of the coarse tiles, in pixels
+    int minTileSize = 16;              // Boundary tiles are halved while the halves are at least this large
+    bool cascade = false;              // Accept clear wood on statistical features first (calibrated cascade)
+    double clearThreshold = -1.0;      // isClearArea threshold on all features; negative disables it
+};
+
+// One classified tile of the map, coarse or refined
+struct LocalizedTile {
+    cv::Rect rect;                     // Position on the board
+    int label = kUnclassifiedLabel;    // Class index, kClearLabel or kUnclassifiedLabel
+    double confidence = 0.0;           // Vote share of the class; 1 for clear wood
+};
+
+// Connected group of map cells with the same defect class
+struct DefectRegion {
+    int label = 0;                     // Class index
+    std::string name;                  // Class name
+    cv::Rect box;                      // Bounding box on the board
+    int area = 0;                      // Board pixels covered by the region's cells
+    double confidence = 0.0;           // Area-weighted mean confidence of those cells
+};
+
+// Label and confidence map of one board. The map is a grid of square cells the size of the smallest
+// tile; every cell holds the result of the smallest tile that covers it.
+struct DefectMap {
+    cv::Size boardSize;
+    int cellSize = 0;                  // Edge length of the cells, in pixels
+    cv::Mat labels;                    // CV_32S: class index, kClearLabel or kUnclassifiedLabel per cell
+    cv::Mat confidence;                // CV_64F: confidence per cell
+    std::vector<LocalizedTile> tiles;  // Leaf tiles, coarse ones first
+    std::vector<DefectRegion> regions; // Merged defect regions in row-major order of their first cell
+    size_t classifiedTiles = 0;        // Tiles classified, refined ones included
+};
+
+// Locates defects on a whole board. The board is classified in coarse tiles; tiles whose label differs
+// from a neighbor's are split into quarters and classified again, down to settings.minTileSize, so
+// only defect outlines are classified at fine resolution. Adjacent cells of the same defect class are
+// then merged into regions with union-find, giving bounding boxes for the cutting optimizer.
+class DefectLocalizer {
+private:
+    const BayesianDefectClassifier& classifier;   // Trained classifier
+    LocalizationSettings settings;
+    int cellSize;                                 // Smallest tile edge reachable by halving settings.tileSize
+
+    // Classifies tiles in parallel, one ExtractionContext per thread
+    void classifyTiles(const cv::Mat& board, std::vector<LocalizedTile>& tiles, WorkStealingPool& pool) const;
+
+public:
+    // Constructor: The classifier must be trained and outlive the localizer
+    DefectLocalizer(const BayesianDefectClassifier& Classifier, const LocalizationSettings& Settings);
+
+    // Edge length of the map cells
+    int getCellSize() const { return cellSize; }
+
+    // Classifies the board coarse-to-fine and merges the defect cells into regions
+    DefectMap localize(const cv::Mat& board, WorkStealingPool& pool) const;
+
+    // Merges 4-connected cells of equal class index (>= 0) into regions. names maps class indices to names.
+    static std::vector<DefectRegion> mergeRegions(const cv::Mat& labels, const cv::Mat& confidence, int cellSize,
+        cv::Size boardSize, const std::vector<std::string>& names);
+};
+
+#endif // DEFECTLOCALIZER_H
@@ -0,0 +1,61 @@
+#ifndef EXTRACTIONCONTEXT_H
+#define EXTRACTIONCONTEXT_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+#include "CooccurrenceStatistics.h"
+#include "GrayLevelQuantizer.h"
+#include "ImageTextureFeatures.h"
+#include "IntensityStatistics.h"
+
+// Reusable buffers for extracting the features of one patch after another: the channel-reduced patch,
+// the quantized levels, the co-occurrence matrix and its list of non-zero cells. The buffers grow to
+// the largest patch seen and are then reused, so a context that has processed one patch of each size
+// extracts further patches without heap allocation. Runs the same extraction steps as ImageTextureFeatures
+// (see ImageTextureFeatures.h), so both give the same features.
+// A context is used by one thread at a time; keep one per worker.
+class ExtractionContext {
+private:
+    ExtractionSettings settings;
+    GrayLevelQuantizer quantizer;      // Refitted to every patch
+    int quantizerBits = 0;             // Bit depth whose input range the quantizer uses, 0 for the type's full range
+    cv::Mat patch;                     // Current patch; a view of the caller's image when it has one channel
+    cv::Mat channelBuffer;             // Single-channel reduction of multi-channel patches
+    cv::Mat quantizedBuffer;           // Quantized levels, unless the quantizer is the identity
+    cv::Mat cooccurrenceMatrix;        // Pair counts (levels x levels, CV_32S), zero outside nonzeroCells
+    std::vector<int> nonzeroCells;     // Flat indices of the non-zero cells of cooccurrenceMatrix
+    StatisticalFeatures statistics;    // Statistical features of the current patch
+    HaralickFeatures texture;          // Texture features of the current patch, valid when hasTexture
+    bool hasPatch = false;
+    bool hasTexture = false;
+
+public:
+    // Constructor: Allocates the co-occurrence matrix for the settings' level count
+    explicit ExtractionContext(const ExtractionSettings& Settings = ExtractionSettings());
+
+    ExtractionContext(const ExtractionContext&) = delete;
+    ExtractionContext& operator=(const ExtractionContext&) = delete;
+
+    const ExtractionSettings& getSettings() const { return settings; }
+
+    // Switches to other settings; the co-occurrence matrix is reallocated only when the level count changes
+    void configure(const ExtractionSettings& Settings);
+
+    // Makes image the current patch and computes its statistical features. The image must stay alive
+    // and unchanged while its features are read. Prints the reason and returns false for unsupported input.
+    bool setPatch(const cv::Mat& image);
+
+    // Statistical features of the current patch; NaN after a rejected patch
+    const StatisticalFeatures& getStatisticalFeatures() const { return statistics; }
+
+    // Texture features of the current patch at the settings' offset, computed on first use
+    const HaralickFeatures& getTextureFeatures();
+
+    // All ten features of the current patch in FeatureVector order
+    FeatureVector getFeatureVector();
+
+    // setPatch() followed by getFeatureVector(); every feature is NaN for unsupported input
+    FeatureVector extract(const cv::Mat& image);
+};
+
+#endif // EXTRACTIONCONTEXT_H
@@ -0,0 +1,63 @@
+#ifndef FEATUREVECTOR_H
+#define FEATUREVECTOR_H
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+struct StatisticalFeatures;
+struct HaralickFeatures;
+
+// Identifiers of the ten features used for classification, in FeatureVector order
+enum class Feature : int {
+    Mean,
+    Variance,
+    Skewness,
+    Kurtosis,
+    Inertia,
+    ClusterShade,
+    ClusterProminence,
+    LocalHomogeneity,
+    Energy,
+    Entropy
+};
+
+constexpr int kFeatureCount = 10;  // Number of features in a FeatureVector
+
+// Fixed-layout feature vector indexed by Feature. A std::vector<FeatureVector> stores many samples
+// as one contiguous row-major matrix, so the classifier never hashes or compares feature names.
+struct FeatureVector {
+    std::array<double, kFeatureCount> values{};
+
+    double& operator[](Feature feature) { return values[static_cast<int>(feature)]; }
+    double operator[](Feature feature) const { return values[static_cast<int>(feature)]; }
+    double& operator[](int index) { return values[index]; }
+    double operator[](int index) const { return values[index]; }
+
+    const double* data() const { return values.data(); }
+};
+
+// Names of the features in FeatureVector order ("mean", "variance", ..., "entropy")
+const std::vector<std::string>& featureNames();
+
+// Index of a feature name in FeatureVector order, or -1 if the name is unknown
+int featureIndex(const std::string& name);
+
+// Converts a string-keyed feature map into a FeatureVector. Names listed in required must be present
+// (std::out_of_range otherwise); any other feature missing from the map is set to NaN.
+FeatureVector toFeatureVector(const std::map<std::string, double>& features, const std::vector<std::string>& required = {});
+
+// Converts a FeatureVector into a string-keyed feature map
+std::map<std::string, double> toFeatureMap(const FeatureVector& features);
+
+// Assembles the ten features from their statistical and texture parts
+FeatureVector makeFeatureVector(const StatisticalFeatures& statistics, const HaralickFeatures& texture);
+
+// Writes the four statistical features into their slots; the texture slots are left as they are
+void setStatisticalFeatures(FeatureVector& features, const StatisticalFeatures& statistics);
+
+// The four statistical features of a feature vector
+StatisticalFeatures toStatisticalFeatures(const FeatureVector& features);
+
+#endif // FEATUREVECTOR_H
@@ -0,0 +1,40 @@
+#ifndef GAUSSIANMODEL_H
+#define GAUSSIANMODEL_H
+
+#include "FeatureVector.h"
+#include <vector>
+#include <cstddef>
+
+// Multivariate normal class-conditional density over a subset of the features.
+// The Cholesky factor of the covariance and the log normalizer are computed once, so scoring a
+// region is one small triangular solve.
+class GaussianModel
+{
+private:
+    std::vector<int> features;        // Feature indices (FeatureVector order) the density is defined over
+    std::vector<double> mean;         // Mean of each selected feature
+    std::vector<double> cholesky;     // Lower-triangular Cholesky factor of the covariance, row-major m x m
+    std::vector<double> inverseDiagonal;  // Reciprocals of the diagonal of cholesky, used by both scoring paths
+    double logNormalizer = 0.0;       // -0.5 * (m * log(2 pi) + log det covariance)
+
+public:
+    GaussianModel() = default;
+
+    // Constructor: Restricts Mean and Covariance (row-major kFeatureCount x kFeatureCount) to Features,
+    // adds Ridge[k] to each diagonal entry, and factorizes the result
+    GaussianModel(const std::vector<int>& Features, const FeatureVector& Mean, const double* Covariance, const FeatureVector& Ridge);
+
+    // Number of features the density is defined over
+    int dimension() const { return static_cast<int>(features.size()); }
+
+    // Log density of one feature vector
+    double logLikelihood(const FeatureVector& x) const;
+
+    // Log densities of count feature vectors, written to out. Regions are processed in blocks whose
+    // triangular solves run across regions in the innermost loop, which the compiler vectorizes.
+    // Each region goes through the same operations as in logLikelihood(), so both give the same values
+    // (GaussianModel.cpp is compiled without floating-point contraction, see CMakeLists.txt).
+    void logLikelihoods(const FeatureVector* regions, size_t count, double* out) const;
+};
+
+#endif // GAUSSIANMODEL_H
@@ -0,0 +1,60 @@
+#ifndef GRAYLEVELQUANTIZER_H
+#define GRAYLEVELQUANTIZER_H
+
+#include <opencv2/core.hpp>
+#include <array>
+#include <vector>
+
+// How gray values are assigned to quantization bins
+enum class QuantizationMode {
+    Uniform,    // Bins of equal width over the input range
+    Equalized   // Bins holding roughly equal numbers of pixels (histogram equalization)
+};
+
+// Maps gray values onto a smaller number of levels.
+// With 32 levels a co-occurrence matrix is 32x32 instead of 256x256 and fits in L1 cache.
+// 8-bit images go through a 256-entry lookup table. 16-bit and 32-bit float images are quantized by kernels
+// specialized at compile time on the pixel type and on power-of-two level counts, over an input range that
+// defaults to the full range of the type (or [0, 1] for float) and can be narrowed to the significant bits
+// of the sensor with setInputRange().
+class GrayLevelQuantizer {
+private:
+    int levels;                       // Number of output gray levels (2..256)
+    QuantizationMode mode;            // Binning strategy
+    int depth = CV_8U;                // Pixel type the quantizer is set up for (CV_8U, CV_16U or CV_32F)
+    bool customRange = false;         // Input range set by setInputRange() rather than by the pixel type
+    double rangeLow = 0.0;            // Input values mapped onto the levels: [rangeLow, rangeHigh)
+    double rangeHigh = 256.0;
+    std::array<uchar, 256> lookup;    // Output level for every 8-bit gray value
+    std::vector<uchar> fineLookup;    // Equalized 16-bit and float images: output level of each fine bin
+
+    void buildUniformLookup();
+
+public:
+    // Number of fine bins the input range is divided into before equalizing 16-bit and float images
+    static const int kFineBins = 4096;
+
+    // Constructor: Builds the uniform lookup table; an Equalized quantizer is refined by fit()
+    GrayLevelQuantizer(int Levels = 256, QuantizationMode Mode = QuantizationMode::Uniform);
+
+    // Number of output gray levels
+    int getLevels() const { return levels; }
+
+    // True when the quantizer maps every 8-bit gray value onto itself
+    bool isIdentity() const { return levels == 256 && mode == QuantizationMode::Uniform && depth == CV_8U && !customRange; }
+
+    // Restricts the input values mapped onto the levels to [Low, High); values outside are clamped.
+    // A 12-bit camera uses [0, 4096) on its CV_16U images.
+    void setInputRange(double Low, double High);
+
+    // Adopts the pixel type of the image and, in Equalized mode, adapts the bins to its histogram
+    void fit(const cv::Mat& image);
+
+    // Writes the quantized levels of a single-channel 8-bit, 16-bit or float image into dst (CV_8UC1)
+    void apply(const cv::Mat& src, cv::Mat& dst) const;
+
+    // Quantized level of a single 8-bit gray value
+    uchar operator()(uchar value) const { return lookup[value]; }
+};
+
+#endif // GRAYLEVELQUANTIZER_H
@@ -2,31 +2,93 @@
 #define IMAGETEXTUREFEATURES_H
 
 #include <opencv2/core.hpp>  // OpenCV core module for Mat class
-#include <tuple>  // To use std::tuple for storing moments
+#include <limits>
 #include <string>
+#include <vector>
+#include "ColorTransform.h"
+#include "CooccurrenceStatistics.h"
+#include "GrayLevelQuantizer.h"
+#include "FeatureVector.h"
+#include "IntensityStatistics.h"
+#include "WorkStealingPool.h"
+
+// Parameters of texture feature extraction shared by a batch of patches
+struct ExtractionSettings {
+    double angle = 0.0;        // Angle of the co-occurrence offset, in degrees
+    double distance = 1.0;     // Distance of the co-occurrence offset, in pixels
+    int levels = 256;          // Gray levels of the co-occurrence matrix
+    QuantizationMode mode = QuantizationMode::Uniform;
+    ColorTransform color = ColorTransform::Luma;  // Reduction of multi-channel images to one channel
+    int channel = 0;           // Channel used by ColorTransform::Channel
+    int bitDepth = 0;          // Significant bits of 16-bit images (e.g. 12); 0 uses the full range of the pixel type
+};
+
+// Extraction steps shared by ImageTextureFeatures and ExtractionContext, so that both give the same features
+
+// Reduces an image to the single channel the features are computed on: a view of a single-channel image, or the
+// settings.color reduction of a multi-channel one, written into buffer (which may be patch itself). Prints the
+// reason and returns false, with patch empty, unless the result is one channel of 8-bit, 16-bit or float pixels.
+bool reduceToFeatureChannel(const cv::Mat& image, const ExtractionSettings& settings, cv::Mat& buffer, cv::Mat& patch);
+
+// Significant bits of a patch of the given depth: settings.bitDepth where it narrows an integer type, otherwise 0
+int significantBits(const ExtractionSettings& settings, int depth);
+
+// Quantizer of the settings; with bits > 0 its input range is [0, 2^bits) instead of the full range of the pixel type
+GrayLevelQuantizer makeQuantizer(const ExtractionSettings& settings, int bits);
+
+// Fits the quantizer to a patch and returns the patch in levels: the patch itself for the identity, otherwise buffer
+const cv::Mat& quantizePatch(GrayLevelQuantizer& quantizer, const cv::Mat& patch, cv::Mat& buffer);
+
+// Replaces the pair counts in matrix (levels x levels, CV_32S, zero outside nonzeroCells) with those of
+// offset (dx, dy) over a level image, and lists the new non-zero cells in nonzeroCells
+void countCooccurrences(const cv::Mat& levelImage, int dx, int dy, cv::Mat& matrix, std::vector<int>& nonzeroCells);
 
 // Class for extracting texture features from an image section using the co-occurrence matrix and other statistical measures.
+// Not thread-safe, even through const methods: the texture getters build the co-occurrence matrix and fill the
+// feature cache on first use. Share an instance between threads only behind a lock, or give each thread its own
+// (extractBatch() and ExtractionContext need no sharing).
 class ImageTextureFeatures {
 private:
     cv::Mat imageSection;          // A section of the image (e.g., a patch or region of interest)
-    cv::Mat cooccurrenceMatrix;    // Co-occurrence matrix for texture analysis
     double angle;                  // Angle used for co-occurrence matrix calculation
     double distance;               // Distance used for co-occurrence matrix calculation
-    std::tuple<double, double> moments;  // Tuple to store the first and second moments
-
-    // Statistical features
-    double mean;
-    double variance;
-    double skewness;
-    double kurtosis;
-
-    // Texture features based on the co-occurrence matrix
-    double clusterShade;
-    double clusterProminence;
-    double localHomogeneity;
-    double energy;
-    double entropy;
-    double inertia;
+
+    // Statistical features; NaN for input the constructor rejects
+    double mean = std::numeric_limits<double>::quiet_NaN();
+    double variance = std::numeric_limits<double>::quiet_NaN();
+    double skewness = std::numeric_limits<double>::quiet_NaN();
+    double kurtosis = std::numeric_limits<double>::quiet_NaN();
+
+    // Memoized texture features of one co-occurrence offset. Features are computed one at a time on demand,
+    // and only the sum groups a feature needs are gathered from the co-occurrence matrix.
+    struct TextureCacheEntry {
+        int dx = 0;                    // Row displacement of the offset (the cache key)
+        int dy = 0;                    // Column displacement of the offset
+        unsigned sumGroups = 0;        // CooccurrenceSumGroup bits already gathered into sums
+        unsigned validFeatures = 0;    // Bits (1 << Feature) of the memoized values
+        CooccurrenceSums sums;         // Sums of the offset's co-occurrence matrix
+        FeatureVector values;          // Memoized feature values
+    };
+    static const size_t kMaxCachedOffsets = 16;  // Oldest offsets are evicted beyond this
+
+    // Texture state. It is computed on first use rather than in the constructor, so patches that are
+    // rejected on their statistical features never build a co-occurrence matrix; hence mutable, and
+    // written by const getters without synchronization.
+    mutable GrayLevelQuantizer quantizer;  // Maps gray values onto the levels of the co-occurrence matrix
+    mutable cv::Mat quantizedSection;      // Image section in quantized levels, used for the co-occurrence matrix
+    mutable cv::Mat cooccurrenceMatrix;    // Co-occurrence matrix for texture analysis (pair counts, CV_32S)
+    mutable std::vector<int> nonzeroCells; // Flat indices of the non-zero cells of the co-occurrence matrix
+    mutable bool hasMatrix = false;        // cooccurrenceMatrix holds the counts of offset (matrixDx, matrixDy)
+    mutable int matrixDx = 0;
+    mutable int matrixDy = 0;
+    mutable std::vector<TextureCacheEntry> textureCache;  // Memoized features per offset, oldest first
+
+    bool isSupportedSection() const;                    // Single channel of 8-bit, 16-bit or float pixels
+    void prepareQuantizedSection() const;               // Quantizes the image section on first use
+    void buildCooccurrenceMatrix(int dx, int dy) const; // Fills cooccurrenceMatrix for the offset unless it already holds it
+    TextureCacheEntry& cacheEntry(int dx, int dy) const;  // Finds or inserts the cache entry of an offset
+    TextureCacheEntry& gatherSums(unsigned groups) const; // Cache entry of the current offset holding the sum groups
+    double textureFeature(Feature feature) const;       // Memoized texture feature of the current offset
 
     // Helper function to convert degrees to radians
     double degToRad(double degree);
@@ -34,13 +96,20 @@ private:
 public:
     std::string regionName;  // Name of the image region
 
-    // Constructor: Initializes the image section, angle, and distance
-    ImageTextureFeatures(const cv::Mat& Image, const std::string& RegionName, double Angle, double Distance);
+    // Constructor: Initializes the image section, angle, and distance.
+    // Levels and Mode select the gray-level quantization of the co-occurrence matrix (Levels x Levels cells).
+    ImageTextureFeatures(const cv::Mat& Image, const std::string& RegionName, double Angle, double Distance,
+        int Levels = 256, QuantizationMode Mode = QuantizationMode::Uniform);
+
+    // Constructor: Takes every parameter from the extraction settings. 8-bit, 16-bit and float images are
+    // accepted; multi-channel images are first reduced to one channel by settings.color.
+    ImageTextureFeatures(const cv::Mat& Image, const std::string& RegionName, const ExtractionSettings& Settings);
 
     // Destructor
     virtual ~ImageTextureFeatures() {}
 
-    // Getters for statistical and texture features
+    // Getters for statistical and texture features. A texture getter computes only its own feature, on first
+    // use for the current angle and distance; the value is memoized per offset.
     double getMean() const;
     double getVariance() const;
     double getSkewness() const;
@@ -53,25 +122,55 @@ public:
     double getEntropy() const;
     double getInertia() const;
 
-    // Set the angle and distance for the co-occurrence matrix calculation
+    // All ten features in FeatureVector order
+    FeatureVector getFeatureVector() const;
+
+    // The four statistical features only; never builds the co-occurrence matrix
+    StatisticalFeatures getStatisticalFeatures() const;
+
+    // True when all six texture features are memoized for the current angle and distance
+    bool hasTextureFeatures() const;
+
+    // Number of gray levels of the co-occurrence matrix
+    int getLevels() const;
+
+    // Set the angle and distance for the co-occurrence matrix calculation; memoized features of other offsets are kept
     void setAngleandDistance(double Angle, double Distance);
 
-    // Methods to calculate the various features
+    // Methods to calculate the various features. The texture methods compute and memoize features of the
+    // current offset ahead of the getters, which otherwise compute them on first use.
     void calculateMean();                  // Calculates the mean of pixel values
     void calculateVariance();              // Calculates the variance of pixel values
     void calculateSkewness();              // Calculates the skewness of pixel values
     void calculateKurtosis();              // Calculates the kurtosis of pixel values
+    void calculateStatisticalFeatures();   // Calculates mean, variance, skewness and kurtosis in one pass
+    // Kept for existing callers: fills the statistical features, as calculateStatisticalFeatures() does.
+    // It no longer stores Mx1 and Mx2 of the co-occurrence matrix; use calculateMultiOffsetFeatures() for those.
+    void calculateMoments();
     void calculateCooccurrenceMatrix();    // Calculates the co-occurrence matrix for texture analysis
-    void calculateMoments();               // Calculates the first and second moments
     void calculateClusterShade();          // Calculates the cluster shade of the co-occurrence matrix
     void calculateClusterProminence();     // Calculates the cluster prominence of the co-occurrence matrix
     void calculateLocalHomogeneity();      // Calculates the local homogeneity of the co-occurrence matrix
     void calculateEnergy();                // Calculates the energy of the co-occurrence matrix
     void calculateEntropy();               // Calculates the entropy of the co-occurrence matrix
     void calculateInertia();               // Calculates the inertia of the co-occurrence matrix
+    void calculateHaralickFeatures();      // Calculates all six texture features at once
 
     // Calculate all texture features
     void calculateTextureFeatures();
+
+    // Calculates the texture features of several offsets with a single pass over the image section, one entry per offset.
+    // With symmetric set, every pair is counted in both directions (the GLCM plus its transpose).
+    std::vector<HaralickFeatures> calculateMultiOffsetFeatures(const std::vector<CooccurrenceOffset>& offsets, bool symmetric = false) const;
+
+    // Extracts the feature vectors of many patches in parallel; results are in input order
+    static std::vector<FeatureVector> extractBatch(const std::vector<cv::Mat>& patches, const ExtractionSettings& settings, WorkStealingPool& pool);
+
+    // Extracts one feature vector per channel of a multi-channel image, in channel order
+    static std::vector<FeatureVector> extractChannelFeatures(const cv::Mat& image, const ExtractionSettings& settings);
+
+    // Calculates rotation-invariant texture features: symmetric features averaged over 0, 45, 90 and 135 degrees
+    HaralickFeatures calculateRotationAveragedFeatures(double Distance) const;
 };
 
 #endif // IMAGETEXTUREFEATURES_H
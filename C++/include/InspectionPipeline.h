@@ -0,0 +1,78 @@
+#ifndef INSPECTIONPIPELINE_H
+#define INSPECTIONPIPELINE_H
+
+#include "BayesianDefectClassifier.h"
+#include "BoundedQueue.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Settings of the streaming board inspection pipeline
+struct PipelineSettings {
+    int tileSize = 64;                 // Edge length of the square tiles, in pixels
+    int tileStride = 64;               // Step between tiles, in pixels
+    ExtractionSettings extraction;     // Texture feature extraction parameters
+    double clearThreshold = -1.0;      // isClearArea threshold; negative disables the clear-area pre-filter
+    bool cascade = false;              // Reject clear wood on statistical features before texture extraction
+    size_t queueCapacity = 64;         // Capacity of every inter-stage queue
+    unsigned extractionWorkers = 1;    // Parallel feature extraction stages
+};
+
+// One decoded board image
+struct BoardFrame {
+    size_t index = 0;                  // Position of the frame in the input stream
+    std::string source;                // File name or stream label
+    cv::Mat image;                     // Grayscale board image
+};
+
+// One tile travelling through the pipeline and, at the end, its classification
+struct TileResult {
+    size_t frame = 0;                  // Index of the frame the tile was cut from
+    std::string source;                // Source of that frame
+    cv::Rect rect;                     // Tile position in the frame
+    cv::Mat tile;                      // Tile pixels (released after feature extraction)
+    FeatureVector features;            // Texture features are NaN for tiles rejected by the cascade
+    bool clear = false;                // Rejected by the cascade or the clear-area pre-filter
+    std::string label;                 // Assigned class
+    bool last = false;                 // Marks the end of the stream
+};
+
+// Per-stage counters: processed items and time spent working (excluding waits on the queues)
+struct StageCounters {
+    std::string name;
+    std::atomic<size_t> items{ 0 };
+    std::atomic<long long> busyNanoseconds{ 0 };
+};
+
+// Streaming inspection: decode -> tile -> feature extraction (N workers) -> clear-area pre-filter -> classification.
+// With settings.cascade the extraction stage first checks the statistical features against the classifier's
+// calibrated clear-wood cascade and skips the co-occurrence matrix of the tiles it accepts.
+// Every stage runs on its own thread and the stages are connected by bounded lock-free SPSC queues, so
+// memory stays bounded when the camera bursts and a slow stage throttles the stages before it.
+// Tiles are dealt round-robin to the extraction workers and collected in the same order, so results
+// come out in input order.
+class InspectionPipeline {
+private:
+    const BayesianDefectClassifier& classifier;   // Trained classifier
+    PipelineSettings settings;
+    std::vector<std::unique_ptr<StageCounters>> counters;
+    double wallSeconds = 0.0;                     // Duration of the last run()
+
+    StageCounters& addStage(const std::string& name);
+
+public:
+    // Constructor: The classifier must be trained before run() is called
+    InspectionPipeline(const BayesianDefectClassifier& Classifier, const PipelineSettings& Settings);
+
+    // Pulls frames from source until it returns false and hands every classified tile to sink, in input order.
+    // The sink runs on the calling thread.
+    void run(const std::function<bool(BoardFrame&)>& source, const std::function<void(const TileResult&)>& sink);
+
+    // Writes items, items per second and utilization of every stage of the last run
+    void reportThroughput(std::ostream& out) const;
+};
+
+#endif // INSPECTIONPIPELINE_H
@@ -0,0 +1,107 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Hot-path metrics. Each metric is a histogram of recorded values: durations in nanoseconds for the
+// timers, plain counts for the others.
+enum class Metric {
+    StatisticalFeatures,   // Timer: mean, variance, skewness and kurtosis of a patch
+    Quantization,          // Timer: gray-level quantization of a patch
+    CooccurrenceMatrix,    // Timer: co-occurrence matrix construction
+    TextureSums,           // Timer: Haralick sums gathered over the non-zero cells
+    Classification,        // Timer: pairwise voting of one feature vector
+    PatchPixels,           // Count: pixels of each patch whose features are extracted
+    NonzeroCells,          // Count: non-zero cells of each co-occurrence matrix
+    VoteMargin             // Count: pairwise votes by which the winning class leads the runner-up
+};
+const int kMetricCount = 8;
+
+// Summary of one metric since the last reset; percentiles are histogram bucket midpoints, within 12.5% of the exact value
+struct MetricSnapshot {
+    std::string name;
+    std::string unit;                 // "ns" for timers, "count" otherwise
+    uint64_t count = 0;               // Recorded values
+    uint64_t sum = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+};
+
+// True when the build records metrics (CMake option ENABLE_INSTRUMENTATION)
+#ifdef LUMBER_INSTRUMENTATION
+constexpr bool kInstrumentationEnabled = true;
+#else
+constexpr bool kInstrumentationEnabled = false;
+#endif
+
+// Adds one value to a metric. Lock-free: relaxed atomic increments on a process-wide histogram.
+void recordMetric(Metric metric, uint64_t value);
+
+// Snapshot of every metric; all counts are zero when instrumentation is compiled out
+std::vector<MetricSnapshot> snapshotMetrics();
+
+// Clears every metric
+void resetMetrics();
+
+// Writes a snapshot as an aligned text table or as a JSON object
+void writeMetricsText(std::ostream& out, const std::vector<MetricSnapshot>& snapshot);
+void writeMetricsJson(std::ostream& out, const std::vector<MetricSnapshot>& snapshot);
+
+// Records the lifetime of the object into a timer metric
+class ScopedTimer {
+private:
+    Metric metric;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ScopedTimer(Metric TimerMetric) : metric{ TimerMetric }, start{ std::chrono::steady_clock::now() } {}
+    ~ScopedTimer() {
+        recordMetric(metric, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count()));
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+// Calls report with a fresh snapshot every interval on a background thread, and once more on destruction
+class MetricsReporter {
+private:
+    std::chrono::milliseconds interval;
+    std::function<void(const std::vector<MetricSnapshot>&)> report;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread thread;
+
+public:
+    MetricsReporter(std::chrono::milliseconds Interval, std::function<void(const std::vector<MetricSnapshot>&)> Report);
+    ~MetricsReporter();
+    MetricsReporter(const MetricsReporter&) = delete;
+    MetricsReporter& operator=(const MetricsReporter&) = delete;
+};
+
+// Instrumentation points. Without LUMBER_INSTRUMENTATION they expand to nothing, so neither the clock
+// reads nor the value expressions are evaluated.
+#define LUMBER_METRIC_CONCAT_(a, b) a##b
+#define LUMBER_METRIC_CONCAT(a, b) LUMBER_METRIC_CONCAT_(a, b)
+#ifdef LUMBER_INSTRUMENTATION
+#define LUMBER_SCOPED_TIMER(metric) ScopedTimer LUMBER_METRIC_CONCAT(scoped_timer_, __LINE__)(metric)
+#define LUMBER_RECORD_METRIC(metric, value) recordMetric(metric, static_cast<uint64_t>(value))
+#else
+#define LUMBER_SCOPED_TIMER(metric) ((void)0)
+#define LUMBER_RECORD_METRIC(metric, value) ((void)0)
+#endif
+
+#endif // INSTRUMENTATION_H
@@ -0,0 +1,59 @@
+#ifndef INTEGRALSTATISTICS_H
+#define INTEGRALSTATISTICS_H
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <vector>
+#include "IntensityStatistics.h"
+#include "CooccurrenceStatistics.h"
+#include "GrayLevelQuantizer.h"
+#include "FeatureVector.h"
+
+// Per-image precomputation that answers feature queries for arbitrary rectangles.
+// Summed-area tables of x, x^2, x^3 and x^4 give the statistical features of any rectangle in O(1).
+// An optional integral co-occurrence histogram at reduced gray levels, sampled on a coarse grid,
+// gives its co-occurrence matrix from four table lookups plus the thin strips between the
+// rectangle and the grid, so texture features cost O(levels^2 + perimeter * cell size).
+class IntegralStatistics {
+private:
+    cv::Mat image;                        // Board image (CV_8UC1)
+    int rows;
+    int cols;
+    std::vector<int64_t> powerTable;      // (rows + 1) x (cols + 1) entries of 4 interleaved power sums
+
+    // Integral co-occurrence histogram (empty until buildCooccurrenceTable())
+    int levels = 0;                       // Gray levels of the histogram
+    int dx = 0;                           // Row displacement of the co-occurrence offset
+    int dy = 0;                           // Column displacement of the co-occurrence offset
+    int cellSize = 1;                     // Grid spacing of the table, in pixels
+    int gridRows = 0;                     // Number of grid lines along the rows (rows / cellSize + 1)
+    int gridCols = 0;                     // Number of grid lines along the columns
+    cv::Mat levelImage;                   // Board in quantized levels
+    std::vector<int32_t> pairTable;       // gridRows x gridCols x levels^2 pair counts of reference pixels above-left
+
+    const int64_t* powerSums(int row, int col) const { return powerTable.data() + 4 * (static_cast<size_t>(row) * (cols + 1) + col); }
+    const int32_t* pairCounts(int gridRow, int gridCol) const;
+    void accumulatePairs(int row_begin, int row_end, int col_begin, int col_end, int64_t* counts) const;
+
+public:
+    // Constructor: Builds the summed-area tables of an 8-bit grayscale image
+    explicit IntegralStatistics(const cv::Mat& Image);
+
+    // Builds the integral co-occurrence histogram for one offset at Levels uniform gray levels,
+    // sampled every CellSize pixels (memory is about (rows / CellSize) * (cols / CellSize) * Levels^2 counts)
+    void buildCooccurrenceTable(int Levels, double Angle, double Distance, int CellSize = 8);
+
+    // True once buildCooccurrenceTable() has been called
+    bool hasCooccurrenceTable() const { return levels > 0; }
+
+    // Mean, variance, skewness and kurtosis of the rectangle, in O(1)
+    StatisticalFeatures regionStatistics(const cv::Rect& roi) const;
+
+    // Texture features of the rectangle from the integral co-occurrence histogram
+    HaralickFeatures regionTexture(const cv::Rect& roi) const;
+
+    // All features of the rectangle; texture features are zero without a co-occurrence table
+    FeatureVector regionFeatures(const cv::Rect& roi) const;
+};
+
+#endif // INTEGRALSTATISTICS_H
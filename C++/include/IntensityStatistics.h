@@ -0,0 +1,40 @@
+#ifndef INTENSITYSTATISTICS_H
+#define INTENSITYSTATISTICS_H
+
+#include <cstdint>  // Fixed-width integers for the exact power sums
+#include <opencv2/core.hpp>
+
+// First-order statistical features of the pixel values of a region
+struct StatisticalFeatures {
+    double mean = 0.0;
+    double variance = 0.0;
+    double skewness = 0.0;
+    double kurtosis = 0.0;
+};
+
+// Running power sums of the pixel values of a region.
+// Pixels can be added and removed in O(1), which lets a sliding window keep its statistics up to date.
+struct IntensitySums {
+    int64_t count = 0;           // Number of pixels
+    int64_t sum[4] = {};         // Sums of x, x^2, x^3 and x^4
+
+    // Adds (sign = +1) or removes (sign = -1) a pixel with the given value
+    void update(int64_t value, int64_t sign) {
+        const int64_t x2 = value * value;
+        count += sign;
+        sum[0] += sign * value;
+        sum[1] += sign * x2;
+        sum[2] += sign * x2 * value;
+        sum[3] += sign * x2 * x2;
+    }
+
+    // Converts the power sums into mean, variance, skewness and kurtosis (population definitions)
+    StatisticalFeatures toFeatures() const;
+};
+
+// Computes the statistical features of a single-channel image in one pass and without heap allocation.
+// 8-bit images go through a 256-bin histogram; 16-bit and floating-point images accumulate power sums
+// about the first pixel value, which keeps the central moments accurate for the full 16-bit range.
+StatisticalFeatures computeStatisticalFeatures(const cv::Mat& image);
+
+#endif // INTENSITYSTATISTICS_H
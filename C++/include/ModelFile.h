@@ -0,0 +1,120 @@
+#ifndef MODELFILE_H
+#define MODELFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "FeatureVector.h"
+
+// Binary layout of a trained classifier, version 1. All sections are fixed-size records written in host
+// byte order and aligned to 8 bytes, so a mapped file is used in place without parsing:
+//   ModelFileHeader
+//   ModelClassRecord[classCount]
+//   ModelPairRecord[pairCount]
+//   int32_t storeLabels[storeCount], padded to 8 bytes
+//   FeatureVector storeFeatures[storeCount]
+// The feature store holds the training samples; a label is a class index, or -1 for clear wood.
+
+const uint32_t kModelFileVersion = 1;
+const uint32_t kModelFileByteOrder = 0x01020304;  // Reads differently on a host of the other byte order
+
+// Bits of ModelFileHeader::flags
+enum ModelFileFlags : uint32_t {
+    kModelHasClearWoodReference = 1u,
+    kModelHasClearCascade = 2u
+};
+
+// Model-wide state
+struct ModelFileHeader {
+    char magic[8];                    // "LDCMODEL"
+    uint32_t version;                 // kModelFileVersion
+    uint32_t byteOrder;               // kModelFileByteOrder
+    uint32_t featureCount;            // kFeatureCount of the writer
+    uint32_t classCount;
+    uint32_t pairCount;
+    uint32_t flags;                   // ModelFileFlags bits
+    uint64_t storeCount;              // Samples in the feature store, 0 without one
+    int32_t featureSetCount;          // Features the classifier selects from
+    int32_t featureSet[kFeatureCount];  // Their indices in FeatureVector order
+    int32_t extractionLevels;         // Extraction settings the samples were computed with
+    int32_t extractionMode;           // QuantizationMode
+    int8_t extractionColor;           // ColorTransform; these three fields were reserved (zero) in earlier files,
+    int8_t extractionChannel;         // which read back as luma over the full range of the pixel type
+    int16_t extractionBitDepth;
+    double extractionAngle;
+    double extractionDistance;
+    double pooledCovariance[kFeatureCount * kFeatureCount];
+    double featureRidge[kFeatureCount];
+    double clearWoodReference[kFeatureCount];
+    double cascadeCenter[4];          // Clear-wood cascade: mean, variance, skewness, kurtosis
+    double cascadeScale[4];
+    double cascadeThreshold;
+    double cascadeRecall;
+};
+
+// Statistics of one defect class
+struct ModelClassRecord {
+    char name[64];                    // Zero-terminated class name
+    int32_t sampleCount;
+    int32_t reserved;
+    double mean[kFeatureCount];
+    double covariance[kFeatureCount * kFeatureCount];  // Row-major
+};
+
+// Feature subset of one class pair
+struct ModelPairRecord {
+    int32_t classI;
+    int32_t classJ;
+    int32_t featureCount;             // Selected features, in selection order
+    int32_t features[kFeatureCount];
+    int32_t reserved;
+};
+
+static_assert(std::is_trivially_copyable<ModelFileHeader>::value && sizeof(ModelFileHeader) % 8 == 0, "ModelFileHeader must be a padded POD");
+static_assert(sizeof(ModelClassRecord) % 8 == 0 && sizeof(ModelPairRecord) % 8 == 0, "Model records must keep 8-byte alignment");
+static_assert(sizeof(FeatureVector) == kFeatureCount * sizeof(double), "FeatureVector must map onto the feature store");
+
+// Read-only view of a model file. The file is memory-mapped, and the accessors point into the mapping,
+// so opening costs one mmap plus validation whatever the size of the feature store.
+class ModelFile {
+private:
+    const char* data = nullptr;       // Start of the mapping
+    size_t size = 0;                  // Mapped bytes
+    std::vector<double> buffer;       // File contents where memory mapping is unavailable
+
+    size_t pairsOffset() const;
+    size_t labelsOffset() const;
+    size_t featuresOffset() const;
+    void close();
+
+public:
+    ModelFile() = default;
+    ModelFile(const ModelFile&) = delete;
+    ModelFile& operator=(const ModelFile&) = delete;
+
+    // Destructor: Unmaps the file
+    ~ModelFile();
+
+    // Maps and validates a model file; prints the reason and returns false if it cannot be used
+    bool open(const std::string& path);
+
+    bool isOpen() const { return data != nullptr; }
+
+    // Sections of the mapped file
+    const ModelFileHeader& header() const { return *reinterpret_cast<const ModelFileHeader*>(data); }
+    const ModelClassRecord* classes() const { return reinterpret_cast<const ModelClassRecord*>(data + sizeof(ModelFileHeader)); }
+    const ModelPairRecord* pairs() const { return reinterpret_cast<const ModelPairRecord*>(data + pairsOffset()); }
+    size_t storeCount() const { return static_cast<size_t>(header().storeCount); }
+    const int32_t* storeLabels() const { return reinterpret_cast<const int32_t*>(data + labelsOffset()); }
+    const FeatureVector* storeFeatures() const { return reinterpret_cast<const FeatureVector*>(data + featuresOffset()); }
+
+    // Writes a model file. The file is written under a temporary name and renamed into place,
+    // so a station never maps a partially written model.
+    static bool write(const std::string& path, const ModelFileHeader& header,
+        const std::vector<ModelClassRecord>& classes, const std::vector<ModelPairRecord>& pairs,
+        const std::vector<int32_t>& storeLabels, const std::vector<FeatureVector>& storeFeatures);
+};
+
+#endif // MODELFILE_H
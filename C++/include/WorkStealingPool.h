@@ -0,0 +1,72 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that execute index ranges from per-worker queues.
+// A worker pops its own queue from the back and steals from the front of the others when it runs dry,
+// so uneven patches (defects are slower than clear wood) still keep every core busy.
+class WorkStealingPool
+{
+public:
+    // Constructor: Starts ThreadCount - 1 workers; the thread calling parallelFor() is the last one
+    explicit WorkStealingPool(unsigned ThreadCount = std::thread::hardware_concurrency());
+
+    // Destructor: Stops and joins the workers
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Number of threads that execute work, including the caller of parallelFor()
+    unsigned threadCount() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Runs body(i) for every i in [0, count) in chunks of Grain indices and returns when all are done.
+    // The first exception thrown by body is rethrown here after the remaining chunks have finished.
+    void parallelFor(size_t count, const std::function<void(size_t)>& body, size_t Grain = 1);
+
+private:
+    // Shared state of one parallelFor() call
+    struct Job {
+        const std::function<void(size_t)>* body = nullptr;
+        std::atomic<size_t> remaining{ 0 };   // Chunks not yet finished
+        std::mutex errorMutex;
+        std::exception_ptr error;
+    };
+
+    // A chunk [begin, end) of a job
+    struct Task {
+        size_t begin;
+        size_t end;
+        Job* job;
+    };
+
+    // Queue owned by one worker (the last one is shared by external callers)
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::atomic<size_t> queuedTasks{ 0 };     // Tasks waiting in any queue
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;    // Signals workers that tasks arrived or the pool stops
+    std::condition_variable doneCondition;    // Signals callers that a job finished or tasks arrived
+    bool stopping = false;
+
+    bool tryRunTask(size_t home);             // Runs one task from queue home or stolen from another queue
+    void runTask(const Task& task);
+    void workerLoop(size_t index);
+};
+
+#endif // WORKSTEALINGPOOL_H
@@ -1,76 +1,226 @@
 #include "BayesianDefectClassifier.h"
+#include "Instrumentation.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// Constructor: Initializes the feature set and resolves every name to its FeatureVector index once
+BayesianDefectClassifier::BayesianDefectClassifier(const std::vector<std::string>& FeatureSet)
+    : featureSet{ FeatureSet } {
+    for (const auto& name : featureSet) {
+        int index = featureIndex(name);
+        if (index < 0) {
+            std::cerr << "Unknown feature \"" << name << "\" is ignored." << std::endl;
+        }
+        else {
+            featureIndices.push_back(index);
+        }
+    }
+}
 
 // Populates defect datasets and defect classes with statistical features
 void BayesianDefectClassifier::fillDefectDatasetsAndDefectClasses(double distance, double angle)
 {
+    defectDatasets.clear();
+    defectClasses.clear();
+    clearWoodSamples.clear();
+    hasClearWoodReference = false;
+    clearCascade.enabled = false;
+
     for (auto& defect : defects) {
-        // Create a map of feature values for the defect
-        std::map<std::string, double> stat_map;
-        stat_map["mean"] = defect->getMean();
-        stat_map["variance"] = defect->getVariance();
-        stat_map["skewness"] = defect->getSkewness();
-        stat_map["kurtosis"] = defect->getKurtosis();
-        stat_map["inertia"] = defect->getInertia();
-        stat_map["cluster_shade"] = defect->getClusterShade();
-        stat_map["cluster_prominence"] = defect->getClusterProminence();
-        stat_map["local_homogeneity"] = defect->getLocalHomogeneity();
-        stat_map["energy"] = defect->getEnergy();
-        stat_map["entropy"] = defect->getEntropy();
+        FeatureVector features = defect->getFeatureVector();
 
         // Check if the defect is a clear area
         if (defect->regionName == "Clear area") {
-            clearWoodReference = stat_map;  // Set as reference for clear wood
-            std::cout << "Clear Wood Reference: " << std::endl;
-            for (const auto& entry : clearWoodReference) {
-                std::cout << entry.first << ": " << entry.second << std::endl;
+            clearWoodReference = features;  // Set as reference for clear wood
+            hasClearWoodReference = true;
+            clearWoodSamples.push_back(features);
+            std::cerr << "Clear Wood Reference: " << std::endl;  // Diagnostics; stdout carries the CSV results
+            for (int k = 0; k < kFeatureCount; ++k) {
+                std::cerr << featureNames()[k] << ": " << clearWoodReference[k] << std::endl;
             }
         }
         else {
-            defectDatasets.push_back(stat_map);
+            defectDatasets.push_back(features);
             defectClasses.push_back(defect->regionName);
         }
     }
 }
 
-// Forward sequential search to find the best feature subset
-std::vector<std::string> BayesianDefectClassifier::forwardSequentialSearch(
-    const std::map<std::string, double>& defect_i,
-    const std::map<std::string, double>& defect_j)
+namespace
 {
-    std::vector<std::string> selected_features;
-    std::vector<std::string> remaining_features = featureSet;
-    double best_likelihood_diff = -std::numeric_limits<double>::infinity();
+    // Selection stops once the subset reaches this fraction of the Bhattacharyya distance of all features
+    const double kSelectionCoverage = 0.99;
+    // ... or once the Bhattacharyya bound on the pairwise error, 0.5 * exp(-distance), drops below this
+    const double kSelectionErrorBound = 1e-4;
+
+    // Cholesky factor of a covariance restricted to the selected features, grown one feature at a time.
+    // Adding a feature costs one forward substitution against the current factor instead of a refactorization.
+    struct IncrementalCholesky
+    {
+        const double* covariance = nullptr;  // Row-major kFeatureCount x kFeatureCount
+        const double* ridge = nullptr;       // Added to the diagonal
+        double weight = 1.0;                 // Scales covariance, so the pooled factor can average two of them
+        const double* covarianceB = nullptr; // Optional second covariance, added with the same weight
+        double factor[kFeatureCount][kFeatureCount];
+        int features[kFeatureCount];
+        int size = 0;
+
+        double entry(int a, int b) const
+        {
+            double value = weight * covariance[a * kFeatureCount + b];
+            if (covarianceB != nullptr) {
+                value += weight * covarianceB[a * kFeatureCount + b];
+            }
+            return a == b ? value + ridge[a] : value;
+        }
 
-    while (!remaining_features.empty()) {
-        std::string best_feature;
-        for (const auto& feature : remaining_features) {
-            std::vector<std::string> test_features = selected_features;
-            test_features.push_back(feature);
+        // New factor row for feature (off-diagonal entries into row, diagonal returned); 0 if not positive definite
+        double extend(int feature, double* row) const
+        {
+            double diagonal = entry(feature, feature);
+            for (int a = 0; a < size; ++a) {
+                double value = entry(features[a], feature);
+                for (int b = 0; b < a; ++b) {
+                    value -= factor[a][b] * row[b];
+                }
+                row[a] = value / factor[a][a];
+                diagonal -= row[a] * row[a];
+            }
+            return diagonal > 0.0 ? std::sqrt(diagonal) : 0.0;
+        }
 
-            std::vector<double> values_i, values_j;
-            for (const auto& f : test_features) {
-                values_i.push_back(defect_i.at(f));
-                values_j.push_back(defect_j.at(f));
+        void append(int feature, const double* row, double diagonal)
+        {
+            for (int b = 0; b < size; ++b) {
+                factor[size][b] = row[b];
             }
+            factor[size][size] = diagonal;
+            features[size++] = feature;
+        }
+    };
 
-            // Placeholder for actual likelihood calculation
-            double likelihood_i = 0.0;
-            double likelihood_j = 0.0;
-            double likelihood_diff = std::abs(likelihood_i - likelihood_j);
+    // Bhattacharyya distance between two Gaussians, grown feature by feature:
+    //   B = 1/8 d' S^-1 d + 1/2 ln(det S / sqrt(det S_i det S_j)),  S = (S_i + S_j) / 2,  d = mean_i - mean_j.
+    // With z = L^-1 d for the pooled factor L, a new feature adds z_new^2 / 8 + ln l - (ln l_i + ln l_j) / 2,
+    // where l, l_i and l_j are the new diagonal entries of the three factors.
+    struct BhattacharyyaSearch
+    {
+        IncrementalCholesky pooled;
+        IncrementalCholesky classI;
+        IncrementalCholesky classJ;
+        double difference[kFeatureCount];
+        double whitened[kFeatureCount];   // z for the selected features
+        double distance = 0.0;
 
-            if (likelihood_diff > best_likelihood_diff) {
-                best_likelihood_diff = likelihood_diff;
-                best_feature = feature;
+        // Row buffers of the last evaluate()
+        double rowPooled[kFeatureCount];
+        double rowI[kFeatureCount];
+        double rowJ[kFeatureCount];
+        double diagonalPooled = 0.0;
+        double diagonalI = 0.0;
+        double diagonalJ = 0.0;
+        double whitenedNew = 0.0;
+
+        BhattacharyyaSearch(const FeatureVector& mean_i, const double* covariance_i,
+            const FeatureVector& mean_j, const double* covariance_j, const FeatureVector& ridge)
+        {
+            pooled.covariance = covariance_i;
+            pooled.covarianceB = covariance_j;
+            pooled.weight = 0.5;
+            pooled.ridge = ridge.data();
+            classI.covariance = covariance_i;
+            classI.ridge = ridge.data();
+            classJ.covariance = covariance_j;
+            classJ.ridge = ridge.data();
+            for (int k = 0; k < kFeatureCount; ++k) {
+                difference[k] = mean_i[k] - mean_j[k];
             }
         }
 
-        if (!best_feature.empty()) {
-            selected_features.push_back(best_feature);
-            remaining_features.erase(
-                std::remove(remaining_features.begin(), remaining_features.end(), best_feature),
-                remaining_features.end());
+        // Gain in distance from adding feature; -infinity if a factor would lose positive definiteness
+        double evaluate(int feature)
+        {
+            diagonalPooled = pooled.extend(feature, rowPooled);
+            diagonalI = classI.extend(feature, rowI);
+            diagonalJ = classJ.extend(feature, rowJ);
+            if (diagonalPooled <= 0.0 || diagonalI <= 0.0 || diagonalJ <= 0.0) {
+                return -std::numeric_limits<double>::infinity();
+            }
+            double projected = difference[feature];
+            for (int a = 0; a < pooled.size; ++a) {
+                projected -= rowPooled[a] * whitened[a];
+            }
+            whitenedNew = projected / diagonalPooled;
+            return whitenedNew * whitenedNew / 8.0 + std::log(diagonalPooled) - 0.5 * (std::log(diagonalI) + std::log(diagonalJ));
         }
-        else {
+
+        // Adds feature; must directly follow evaluate(feature)
+        void accept(int feature, double gain)
+        {
+            whitened[pooled.size] = whitenedNew;
+            pooled.append(feature, rowPooled, diagonalPooled);
+            classI.append(feature, rowI, diagonalI);
+            classJ.append(feature, rowJ, diagonalJ);
+            distance += gain;
+        }
+    };
+}
+
+// Greedy forward selection on the Bhattacharyya distance between the two class Gaussians.
+// The distance of all candidate features bounds the distance of every subset, since adding a feature never
+// lowers it. That bound prunes the search: a step ends as soon as a candidate reaches it, and the search
+// ends once the subset covers kSelectionCoverage of it or the pairwise error bound is negligible.
+// Every evaluation extends the current Cholesky factors by one row, so a pair costs O(F^4) flops at most
+// and allocates only the result.
+std::vector<int> BayesianDefectClassifier::selectFeatures(const FeatureVector& mean_i, const double* covariance_i,
+    const FeatureVector& mean_j, const double* covariance_j) const
+{
+    std::vector<int> selected_features;
+    if (featureIndices.empty()) {
+        return selected_features;
+    }
+
+    BhattacharyyaSearch full(mean_i, covariance_i, mean_j, covariance_j, featureRidge);
+    for (int feature : featureIndices) {
+        double gain = full.evaluate(feature);
+        if (gain > -std::numeric_limits<double>::infinity()) {
+            full.accept(feature, gain);
+        }
+    }
+    const double bound = full.distance;
+
+    BhattacharyyaSearch search(mean_i, covariance_i, mean_j, covariance_j, featureRidge);
+    int remaining[kFeatureCount];
+    int remaining_count = 0;
+    for (int feature : featureIndices) {
+        remaining[remaining_count++] = feature;
+    }
+
+    while (remaining_count > 0) {
+        int best_slot = -1;
+        double best_gain = -std::numeric_limits<double>::infinity();
+        for (int slot = 0; slot < remaining_count; ++slot) {
+            double gain = search.evaluate(remaining[slot]);
+            if (gain > best_gain) {
+                best_gain = gain;
+                best_slot = slot;
+                if (search.distance + gain >= bound * (1.0 - 1e-12)) {
+                    break;  // No other candidate can do better than reaching the bound
+                }
+            }
+        }
+        if (best_slot < 0 || (!selected_features.empty() && best_gain <= 0.0)) {
+            break;
+        }
+
+        int best_feature = remaining[best_slot];
+        search.evaluate(best_feature);
+        search.accept(best_feature, best_gain);
+        selected_features.push_back(best_feature);
+        remaining[best_slot] = remaining[--remaining_count];
+
+        if (search.distance >= kSelectionCoverage * bound || 0.5 * std::exp(-search.distance) < kSelectionErrorBound) {
             break;
         }
     }
@@ -78,55 +228,569 @@ std::vector<std::string> BayesianDefectClassifier::forwardSequentialSearch(
     return selected_features;
 }
 
-// Classifies the lumber defect based on the given region features
-std::string BayesianDefectClassifier::classifyLumberDefect(const std::map<std::string, double>& regionFeatures)
+// Forward sequential search to find the best feature subset. Trains first if needed, since the pooled
+// covariance and the feature ridge come from training.
+std::vector<int> BayesianDefectClassifier::forwardSequentialSearch(const FeatureVector& defect_i, const FeatureVector& defect_j)
+{
+    if (!trained) {
+        train();
+    }
+
+    return selectFeatures(defect_i, pooledCovariance.data(), defect_j, pooledCovariance.data());
+}
+
+// String-keyed adapter for forwardSequentialSearch
+std::vector<std::string> BayesianDefectClassifier::forwardSequentialSearch(
+    const std::map<std::string, double>& defect_i,
+    const std::map<std::string, double>& defect_j)
+{
+    std::vector<std::string> selected_names;
+    for (int feature : forwardSequentialSearch(toFeatureVector(defect_i, featureSet), toFeatureVector(defect_j, featureSet))) {
+        selected_names.push_back(featureNames()[feature]);
+    }
+    return selected_names;
+}
+
+// Trains on a temporary pool with one thread per core
+void BayesianDefectClassifier::train()
+{
+    WorkStealingPool pool;
+    train(pool);
+}
+
+// Builds the model: groups the datasets by class, computes each class mean and covariance,
+// and runs the feature subset search once per class pair, with the pairs in parallel
+void BayesianDefectClassifier::train(WorkStealingPool& pool)
 {
     fillDefectDatasetsAndDefectClasses(0.0, 0.0);  // Placeholder for distance and angle
-    int n = defectDatasets.size();
-    std::vector<int> wins(n, 0);
+    classModels.clear();
+    pairModels.clear();
+
+    std::vector<int> sample_class(defectDatasets.size());
+    for (size_t s = 0; s < defectDatasets.size(); ++s) {
+        auto it = std::find_if(classModels.begin(), classModels.end(),
+            [&](const DefectClassModel& model) { return model.name == defectClasses[s]; });
+        if (it == classModels.end()) {
+            classModels.push_back(DefectClassModel());
+            classModels.back().name = defectClasses[s];
+            it = classModels.end() - 1;
+        }
+        sample_class[s] = static_cast<int>(it - classModels.begin());
+        it->sampleCount += 1;
+        for (int k = 0; k < kFeatureCount; ++k) {
+            it->mean[k] += defectDatasets[s][k];
+        }
+    }
+    for (auto& model : classModels) {
+        for (int k = 0; k < kFeatureCount; ++k) {
+            model.mean[k] /= model.sampleCount;
+        }
+    }
+
+    // Covariance of all defect samples; a small fraction of its diagonal regularizes every class covariance,
+    // which keeps single-sample classes and nearly constant features factorizable
+    pooledCovariance.fill(0.0);
+    FeatureVector pooled_mean;
+    for (const auto& sample : defectDatasets) {
+        for (int k = 0; k < kFeatureCount; ++k) {
+            pooled_mean[k] += sample[k] / defectDatasets.size();
+        }
+    }
+    for (const auto& sample : defectDatasets) {
+        for (int a = 0; a < kFeatureCount; ++a) {
+            for (int b = 0; b < kFeatureCount; ++b) {
+                pooledCovariance[a * kFeatureCount + b] += (sample[a] - pooled_mean[a]) * (sample[b] - pooled_mean[b]) / defectDatasets.size();
+            }
+        }
+    }
+    for (int k = 0; k < kFeatureCount; ++k) {
+        featureRidge[k] = 1e-3 * pooledCovariance[k * kFeatureCount + k] + 1e-12;
+    }
 
+    // Sample covariance (divided by n - 1); a single-sample class keeps a zero covariance
+    for (size_t s = 0; s < defectDatasets.size(); ++s) {
+        DefectClassModel& model = classModels[sample_class[s]];
+        if (model.sampleCount < 2) {
+            continue;
+        }
+        for (int a = 0; a < kFeatureCount; ++a) {
+            double da = defectDatasets[s][a] - model.mean[a];
+            for (int b = 0; b < kFeatureCount; ++b) {
+                model.covariance[a * kFeatureCount + b] += da * (defectDatasets[s][b] - model.mean[b]) / (model.sampleCount - 1);
+            }
+        }
+    }
+
+    // Class pairs are independent; each selects its features and factorizes its models in its own slot
+    int n = static_cast<int>(classModels.size());
     for (int i = 0; i < n; ++i) {
         for (int j = i + 1; j < n; ++j) {
-            auto selected_features = forwardSequentialSearch(defectDatasets[i], defectDatasets[j]);
+            ClassPairModel pair;
+            pair.classI = i;
+            pair.classJ = j;
+            pairModels.push_back(pair);
+        }
+    }
+    pool.parallelFor(pairModels.size(), [&](size_t p) {
+        ClassPairModel& pair = pairModels[p];
+        const DefectClassModel& model_i = classModels[pair.classI];
+        const DefectClassModel& model_j = classModels[pair.classJ];
+        pair.selectedFeatures = selectFeatures(model_i.mean, model_i.covariance.data(), model_j.mean, model_j.covariance.data());
+        pair.modelI = GaussianModel(pair.selectedFeatures, model_i.mean, model_i.covariance.data(), featureRidge);
+        pair.modelJ = GaussianModel(pair.selectedFeatures, model_j.mean, model_j.covariance.data(), featureRidge);
+    });
+
+    trained = true;
+}
+
+// Writes the trained state and, optionally, the training samples to a model file
+bool BayesianDefectClassifier::saveModel(const std::string& path, const ExtractionSettings& settings, bool includeFeatureStore) const
+{
+    if (!trained) {
+        std::cerr << "The classifier must be trained before it is saved." << std::endl;
+        return false;
+    }
+
+    ModelFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.flags = (hasClearWoodReference ? kModelHasClearWoodReference : 0u) | (clearCascade.enabled ? kModelHasClearCascade : 0u);
+    header.featureSetCount = static_cast<int32_t>(featureIndices.size());
+    std::copy(featureIndices.begin(), featureIndices.end(), header.featureSet);
+    header.extractionLevels = settings.levels;
+    header.extractionMode = static_cast<int32_t>(settings.mode);
+    header.extractionColor = static_cast<int8_t>(settings.color);
+    header.extractionChannel = static_cast<int8_t>(settings.channel);
+    header.extractionBitDepth = static_cast<int16_t>(settings.bitDepth);
+    header.extractionAngle = settings.angle;
+    header.extractionDistance = settings.distance;
+    std::copy(pooledCovariance.begin(), pooledCovariance.end(), header.pooledCovariance);
+    std::copy(featureRidge.values.begin(), featureRidge.values.end(), header.featureRidge);
+    std::copy(clearWoodReference.values.begin(), clearWoodReference.values.end(), header.clearWoodReference);
+    const StatisticalFeatures& center = clearCascade.center;
+    const StatisticalFeatures& scale = clearCascade.scale;
+    const double cascade_center[4] = { center.mean, center.variance, center.skewness, center.kurtosis };
+    const double cascade_scale[4] = { scale.mean, scale.variance, scale.skewness, scale.kurtosis };
+    std::copy(cascade_center, cascade_center + 4, header.cascadeCenter);
+    std::copy(cascade_scale, cascade_scale + 4, header.cascadeScale);
+    header.cascadeThreshold = clearCascade.threshold;
+    header.cascadeRecall = clearCascade.recall;
+
+    std::vector<ModelClassRecord> classes(classModels.size());
+    for (size_t c = 0; c < classModels.size(); ++c) {
+        const DefectClassModel& model = classModels[c];
+        ModelClassRecord& record = classes[c];
+        std::memset(&record, 0, sizeof(record));
+        if (model.name.size() >= sizeof(record.name)) {
+            std::cerr << "Class name too long for the model file: " << model.name << std::endl;
+            return false;
+        }
+        std::memcpy(record.name, model.name.data(), model.name.size());
+        record.sampleCount = model.sampleCount;
+        std::copy(model.mean.values.begin(), model.mean.values.end(), record.mean);
+        std::copy(model.covariance.begin(), model.covariance.end(), record.covariance);
+    }
+
+    std::vector<ModelPairRecord> pairs(pairModels.size());
+    for (size_t p = 0; p < pairModels.size(); ++p) {
+        ModelPairRecord& record = pairs[p];
+        std::memset(&record, 0, sizeof(record));
+        record.classI = pairModels[p].classI;
+        record.classJ = pairModels[p].classJ;
+        record.featureCount = static_cast<int32_t>(pairModels[p].selectedFeatures.size());
+        std::copy(pairModels[p].selectedFeatures.begin(), pairModels[p].selectedFeatures.end(), record.features);
+    }
+
+    // Feature store: clear-wood samples labelled -1, defect samples labelled with their class index.
+    // A loaded model passes its mapped store on.
+    std::vector<int32_t> labels;
+    std::vector<FeatureVector> features;
+    if (includeFeatureStore && modelFile && defectDatasets.empty() && clearWoodSamples.empty()) {
+        labels.assign(modelFile->storeLabels(), modelFile->storeLabels() + modelFile->storeCount());
+        features.assign(modelFile->storeFeatures(), modelFile->storeFeatures() + modelFile->storeCount());
+    }
+    else if (includeFeatureStore) {
+        for (const auto& sample : clearWoodSamples) {
+            labels.push_back(-1);
+            features.push_back(sample);
+        }
+        for (size_t s = 0; s < defectDatasets.size(); ++s) {
+            auto it = std::find_if(classModels.begin(), classModels.end(),
+                [&](const DefectClassModel& model) { return model.name == defectClasses[s]; });
+            labels.push_back(static_cast<int32_t>(it - classModels.begin()));
+            features.push_back(defectDatasets[s]);
+        }
+    }
+
+    return ModelFile::write(path, header, classes, pairs, labels, features);
+}
+
+// Restores the trained state from a model file; only the small per-class and per-pair state is copied
+bool BayesianDefectClassifier::loadModel(const std::string& path, ExtractionSettings& settings)
+{
+    auto file = std::make_shared<ModelFile>();
+    if (!file->open(path)) {
+        return false;
+    }
+    const ModelFileHeader& header = file->header();
+
+    settings.levels = header.extractionLevels;
+    settings.mode = static_cast<QuantizationMode>(header.extractionMode);
+    settings.color = static_cast<ColorTransform>(header.extractionColor);
+    settings.channel = header.extractionChannel;
+    settings.bitDepth = header.extractionBitDepth;
+    settings.angle = header.extractionAngle;
+    settings.distance = header.extractionDistance;
+    featureIndices.assign(header.featureSet, header.featureSet + header.featureSetCount);
+    featureSet.clear();
+    for (int index : featureIndices) {
+        featureSet.push_back(featureNames()[index]);
+    }
+    std::copy(header.pooledCovariance, header.pooledCovariance + kFeatureCount * kFeatureCount, pooledCovariance.begin());
+    std::copy(header.featureRidge, header.featureRidge + kFeatureCount, featureRidge.values.begin());
+    std::copy(header.clearWoodReference, header.clearWoodReference + kFeatureCount, clearWoodReference.values.begin());
+    hasClearWoodReference = (header.flags & kModelHasClearWoodReference) != 0;
+    clearCascade.enabled = (header.flags & kModelHasClearCascade) != 0;
+    clearCascade.center = { header.cascadeCenter[0], header.cascadeCenter[1], header.cascadeCenter[2], header.cascadeCenter[3] };
+    clearCascade.scale = { header.cascadeScale[0], header.cascadeScale[1], header.cascadeScale[2], header.cascadeScale[3] };
+    clearCascade.threshold = header.cascadeThreshold;
+    clearCascade.recall = header.cascadeRecall;
+
+    classModels.assign(header.classCount, DefectClassModel());
+    for (uint32_t c = 0; c < header.classCount; ++c) {
+        const ModelClassRecord& record = file->classes()[c];
+        DefectClassModel& model = classModels[c];
+        model.name.assign(record.name, strnlen(record.name, sizeof(record.name)));
+        model.sampleCount = record.sampleCount;
+        std::copy(record.mean, record.mean + kFeatureCount, model.mean.values.begin());
+        std::copy(record.covariance, record.covariance + kFeatureCount * kFeatureCount, model.covariance.begin());
+    }
+
+    pairModels.clear();
+    for (uint32_t p = 0; p < header.pairCount; ++p) {
+        const ModelPairRecord& record = file->pairs()[p];
+        ClassPairModel pair;
+        pair.classI = record.classI;
+        pair.classJ = record.classJ;
+        pair.selectedFeatures.assign(record.features, record.features + record.featureCount);
+        pair.modelI = GaussianModel(pair.selectedFeatures, classModels[pair.classI].mean, classModels[pair.classI].covariance.data(), featureRidge);
+        pair.modelJ = GaussianModel(pair.selectedFeatures, classModels[pair.classJ].mean, classModels[pair.classJ].covariance.data(), featureRidge);
+        pairModels.push_back(pair);
+    }
+
+    // The samples stay in the mapped feature store; the training inputs no longer describe this model
+    defectDatasets.clear();
+    defectClasses.clear();
+    clearWoodSamples.clear();
+    modelFile = file;
+    trained = true;
+    return true;
+}
 
-            std::vector<double> data_i, data_j;
-            for (const auto& feature : selected_features) {
-                data_i.push_back(regionFeatures.at(feature));
-                data_j.push_back(defectDatasets[j].at(feature));
+namespace
+{
+    // Votes by which the winner leads the runner-up, 0 for a tie broken by class order. A small margin marks
+    // a region near a decision boundary. Only evaluated when instrumentation is compiled in.
+    inline int voteMargin(const int* wins, int n, int winner)
+    {
+        int runner_up = 0;
+        for (int c = 0; c < n; ++c) {
+            if (c != winner) {
+                runner_up = std::max(runner_up, wins[c]);
             }
+        }
+        return wins[winner] - runner_up;
+    }
+}
+
+// Pairwise voting over the trained class pairs. The vote tally lives in a per-thread buffer,
+// so repeated calls neither allocate nor modify the classifier.
+int BayesianDefectClassifier::predictClassIndex(const FeatureVector& regionFeatures, double* voteShare) const
+{
+    int n = static_cast<int>(classModels.size());
+    if (n == 0) {
+        return -1;
+    }
+    LUMBER_SCOPED_TIMER(Metric::Classification);
+
+    thread_local std::vector<int> wins;
+    wins.assign(n, 0);
+
+    for (const auto& pair : pairModels) {
+        double likelihood_i = pair.modelI.logLikelihood(regionFeatures);
+        double likelihood_j = pair.modelJ.logLikelihood(regionFeatures);
+
+        if (likelihood_i > likelihood_j) {
+            wins[pair.classI] += 1;
+        }
+        else {
+            wins[pair.classJ] += 1;
+        }
+    }
+
+    auto winner = std::max_element(wins.begin(), wins.end());
+    LUMBER_RECORD_METRIC(Metric::VoteMargin, voteMargin(wins.data(), n, static_cast<int>(winner - wins.begin())));
+    if (voteShare != nullptr) {
+        *voteShare = n > 1 ? static_cast<double>(*winner) / (n - 1) : 1.0;
+    }
+    return static_cast<int>(std::distance(wins.begin(), winner));
+}
+
+// Batch pairwise voting: each class pair scores every region with the vectorized likelihood kernel.
+// Votes and ties are resolved as in predictClassIndex(); the buffers are per thread.
+void BayesianDefectClassifier::predictClassIndices(const FeatureVector* regions, size_t count, int* classIndices) const
+{
+    int n = static_cast<int>(classModels.size());
+    if (n == 0) {
+        std::fill(classIndices, classIndices + count, -1);
+        return;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    thread_local std::vector<int> wins;
+    thread_local std::vector<double> likelihood_i, likelihood_j;
+    wins.assign(count * n, 0);
+    likelihood_i.resize(count);
+    likelihood_j.resize(count);
+    for (const auto& pair : pairModels) {
+        pair.modelI.logLikelihoods(regions, count, likelihood_i.data());
+        pair.modelJ.logLikelihoods(regions, count, likelihood_j.data());
+        for (size_t r = 0; r < count; ++r) {
+            wins[r * n + (likelihood_i[r] > likelihood_j[r] ? pair.classI : pair.classJ)] += 1;
+        }
+    }
+
+    for (size_t r = 0; r < count; ++r) {
+        const int* row = wins.data() + r * n;
+        classIndices[r] = static_cast<int>(std::max_element(row, row + n) - row);
+        LUMBER_RECORD_METRIC(Metric::VoteMargin, voteMargin(row, n, classIndices[r]));
+    }
+}
+
+// Vector adapter for predictClassIndices
+void BayesianDefectClassifier::predictClassIndices(const std::vector<FeatureVector>& regions, std::vector<int>& classIndices) const
+{
+    classIndices.resize(regions.size());
+    predictClassIndices(regions.data(), regions.size(), classIndices.data());
+}
+
+// Classifies the lumber defect based on the given region features
+std::string BayesianDefectClassifier::classifyLumberDefect(const FeatureVector& regionFeatures)
+{
+    if (!trained) {
+        train();
+    }
+
+    int max_index = predictClassIndex(regionFeatures);
+    return max_index < 0 ? std::string() : classModels[max_index].name;
+}
+
+// String-keyed adapter for classifyLumberDefect
+std::string BayesianDefectClassifier::classifyLumberDefect(const std::map<std::string, double>& regionFeatures)
+{
+    return classifyLumberDefect(toFeatureVector(regionFeatures, featureSet));
+}
+
+// Classifies many feature vectors in parallel. The model is trained up front on the same pool, so the
+// workers only run the read-only predictClassIndices(), one block of regions per task, and each writes
+// its own slots of the result.
+std::vector<std::string> BayesianDefectClassifier::classifyBatch(const std::vector<FeatureVector>& regions, WorkStealingPool& pool)
+{
+    if (!trained) {
+        train(pool);
+    }
+
+    const size_t block = 64;  // Regions per task: one block of the batch likelihood kernel
+    std::vector<int> indices(regions.size(), -1);
+    pool.parallelFor((regions.size() + block - 1) / block, [&](size_t b) {
+        size_t begin = b * block;
+        predictClassIndices(regions.data() + begin, std::min(block, regions.size() - begin), indices.data() + begin);
+    });
+
+    std::vector<std::string> labels(regions.size());
+    for (size_t i = 0; i < regions.size(); ++i) {
+        if (indices[i] >= 0) {
+            labels[i] = classModels[indices[i]].name;
+        }
+    }
+    return labels;
+}
 
-            // Placeholder for actual likelihood calculation
-            double likelihood_i = 0.0;
-            double likelihood_j = 0.0;
+// Extracts features from image tiles and classifies them in parallel
+std::vector<std::string> BayesianDefectClassifier::classifyBatch(const std::vector<cv::Mat>& tiles,
+    const ExtractionSettings& settings, WorkStealingPool& pool)
+{
+    return classifyBatch(ImageTextureFeatures::extractBatch(tiles, settings, pool), pool);
+}
+
+// Classifies the regions of interest of one image; the tiles share the image data
+std::vector<std::string> BayesianDefectClassifier::classifyRegions(const cv::Mat& image, const std::vector<cv::Rect>& rois,
+    const ExtractionSettings& settings, WorkStealingPool& pool)
+{
+    std::vector<cv::Mat> tiles;
+    tiles.reserve(rois.size());
+    for (const auto& roi : rois) {
+        tiles.push_back(image(roi));
+    }
+    return classifyBatch(tiles, settings, pool);
+}
+
+// Classifies every window of a feature map produced by BoardTextureScanner, in row-major order
+std::vector<std::string> BayesianDefectClassifier::classifyFeatureMap(const cv::Mat& featureMap)
+{
+    std::vector<std::string> labels;
+    labels.reserve(featureMap.total());
+    for (int r = 0; r < featureMap.rows; ++r) {
+        for (int c = 0; c < featureMap.cols; ++c) {
+            labels.push_back(classifyLumberDefect(BoardTextureScanner::windowFeatureVector(featureMap, r, c)));
+        }
+    }
+    return labels;
+}
+
+// Calibrates the cascade threshold on the training samples. The threshold is the targetRecall quantile
+// of the clear-wood distances, lowered below the nearest defect sample so that no training defect is
+// ever rejected by the first stage.
+bool BayesianDefectClassifier::calibrateClearCascade(double targetRecall)
+{
+    if (!trained) {
+        train();
+    }
+    if (clearWoodSamples.empty()) {  // E.g. a loaded model without feature store: keep its stored cascade
+        std::cerr << "No clear-wood samples to calibrate the cascade." << std::endl;
+        return false;
+    }
+    clearCascade.enabled = false;
 
-            if (likelihood_i > likelihood_j) {
-                wins[i] += 1;
+    // Center on the clear-wood mean; scale by the variance of all samples so the features are comparable
+    double center[4] = { 0.0, 0.0, 0.0, 0.0 };
+    for (const auto& sample : clearWoodSamples) {
+        for (int k = 0; k < 4; ++k) {
+            center[k] += sample[k];
+        }
+    }
+    for (int k = 0; k < 4; ++k) {
+        center[k] /= clearWoodSamples.size();
+    }
+
+    double scale[4] = { 0.0, 0.0, 0.0, 0.0 };
+    double all_mean[4] = { 0.0, 0.0, 0.0, 0.0 };
+    size_t total = clearWoodSamples.size() + defectDatasets.size();
+    for (const auto* samples : { &clearWoodSamples, &defectDatasets }) {
+        for (const auto& sample : *samples) {
+            for (int k = 0; k < 4; ++k) {
+                all_mean[k] += sample[k] / total;
             }
-            else {
-                wins[j] += 1;
+        }
+    }
+    for (const auto* samples : { &clearWoodSamples, &defectDatasets }) {
+        for (const auto& sample : *samples) {
+            for (int k = 0; k < 4; ++k) {
+                double diff = sample[k] - all_mean[k];
+                scale[k] += diff * diff / total;
             }
         }
     }
+    for (int k = 0; k < 4; ++k) {
+        scale[k] += 1e-12 * (1.0 + all_mean[k] * all_mean[k]);  // A constant feature must not divide by zero
+    }
+
+    clearCascade.center = { center[0], center[1], center[2], center[3] };
+    clearCascade.scale = { scale[0], scale[1], scale[2], scale[3] };
+
+    std::vector<double> clear_distances;
+    clear_distances.reserve(clearWoodSamples.size());
+    for (const auto& sample : clearWoodSamples) {
+        clear_distances.push_back(clearCascadeDistance(toStatisticalFeatures(sample)));
+    }
+    std::sort(clear_distances.begin(), clear_distances.end());
 
-    int max_index = std::distance(wins.begin(), std::max_element(wins.begin(), wins.end()));
-    return defectClasses[max_index];
+    double nearest_defect = std::numeric_limits<double>::infinity();
+    for (const auto& sample : defectDatasets) {
+        nearest_defect = std::min(nearest_defect, clearCascadeDistance(toStatisticalFeatures(sample)));
+    }
+
+    double recall = std::min(std::max(targetRecall, 0.0), 1.0);
+    size_t rank = static_cast<size_t>(std::ceil(recall * clear_distances.size()));
+    double threshold = clear_distances[rank == 0 ? 0 : rank - 1];
+    if (clear_distances.size() < 2 && std::isfinite(nearest_defect)) {
+        threshold = 0.5 * nearest_defect;  // A single sample gives no spread; accept up to halfway to the nearest defect
+    }
+    if (threshold >= nearest_defect) {
+        threshold = std::nextafter(nearest_defect, 0.0);
+    }
+
+    clearCascade.threshold = threshold;
+    clearCascade.recall = static_cast<double>(std::upper_bound(clear_distances.begin(), clear_distances.end(), threshold)
+        - clear_distances.begin()) / clear_distances.size();
+    clearCascade.enabled = true;
+    return true;
 }
 
-// Checks if the test region of interest (ROI) is a clear area based on the given threshold
-bool BayesianDefectClassifier::isClearArea(const std::map<std::string, double>& testROI, double thresh)
+// Mean squared standardized difference over the four statistical features
+double BayesianDefectClassifier::clearCascadeDistance(const StatisticalFeatures& stats) const
 {
-    std::vector<double> x_vector, reference_vector;
+    const ClearWoodCascade& c = clearCascade;
+    double diff[4] = { stats.mean - c.center.mean, stats.variance - c.center.variance,
+        stats.skewness - c.center.skewness, stats.kurtosis - c.center.kurtosis };
+    double scale[4] = { c.scale.mean, c.scale.variance, c.scale.skewness, c.scale.kurtosis };
 
-    for (const auto& feature : clearWoodReference) {
-        x_vector.push_back(testROI.at(feature.first));
-        reference_vector.push_back(feature.second);
+    double distance = 0.0;
+    for (int k = 0; k < 4; ++k) {
+        distance += diff[k] * diff[k] / scale[k];
+    }
+    return distance / 4;
+}
+
+// True when the first stage of the cascade accepts the patch as clear wood
+bool BayesianDefectClassifier::passesClearCascade(const StatisticalFeatures& stats) const
+{
+    return clearCascade.enabled && clearCascadeDistance(stats) <= clearCascade.threshold;
+}
+
+// Classifies a patch through the cascade; texture features are only computed past the first stage
+std::string BayesianDefectClassifier::classifyPatch(const ImageTextureFeatures& patch)
+{
+    if (passesClearCascade(patch.getStatisticalFeatures())) {
+        return "Clear area";
+    }
+    return classifyLumberDefect(patch.getFeatureVector());
+}
+
+// Checks if the test region of interest (ROI) is a clear area based on the given threshold
+bool BayesianDefectClassifier::isClearArea(const FeatureVector& testROI, double thresh) const
+{
+    if (!hasClearWoodReference) {
+        return false;
     }
 
     double test_statistic = 0.0;
-    for (size_t i = 0; i < x_vector.size(); ++i) {
-        test_statistic += std::pow(x_vector[i] - reference_vector[i], 2);
+    for (int k = 0; k < kFeatureCount; ++k) {
+        double diff = testROI[k] - clearWoodReference[k];
+        test_statistic += diff * diff;
     }
-    test_statistic /= x_vector.size();
+    test_statistic /= kFeatureCount;
 
     return test_statistic <= thresh;
 }
+
+// String-keyed adapter for isClearArea; every feature of the reference must be present
+bool BayesianDefectClassifier::isClearArea(const std::map<std::string, double>& testROI, double thresh) const
+{
+    if (!hasClearWoodReference) {
+        return false;
+    }
+    return isClearArea(toFeatureVector(testROI, featureNames()), thresh);
+}
+
+// Checks many candidate boxes of one board with features read from its integral statistics
+std::vector<bool> BayesianDefectClassifier::screenClearAreas(const IntegralStatistics& integral,
+    const std::vector<cv::Rect>& boxes, double thresh) const
+{
+    std::vector<bool> clear(boxes.size(), false);
+    for (size_t b = 0; b < boxes.size(); ++b) {
+        clear[b] = isClearArea(integral.regionFeatures(boxes[b]), thresh);
+    }
+    return clear;
+}
@@ -0,0 +1,191 @@
+#include "BoardTextureScanner.h"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+// Constructor: Stores the board and converts the angle and distance into a pixel displacement
+BoardTextureScanner::BoardTextureScanner(const cv::Mat& Board, int WindowRows, int WindowCols, int Stride, double Angle, double Distance,
+    int Levels, QuantizationMode Mode)
+    : board{ Board },
+    quantizer{ Levels, Mode },
+    windowRows{ WindowRows },
+    windowCols{ WindowCols },
+    stride{ Stride },
+    top{ 0 },
+    left{ 0 },
+    cooccurrenceFreq{ cv::Mat::zeros(quantizer.getLevels(), quantizer.getLevels(), CV_32S) } {
+
+    // Same displacement convention as ImageTextureFeatures::calculateCooccurrenceMatrix()
+    CooccurrenceOffset offset{ Angle, Distance };
+    dx = offset.rowShift();
+    dy = offset.colShift();
+}
+
+// Returns the features of the window at (row, col) of a feature map
+FeatureVector BoardTextureScanner::windowFeatureVector(const cv::Mat& featureMap, int row, int col) {
+    FeatureVector features;
+    const double* values = featureMap.ptr<double>(row) + col * kFeatureCount;
+    std::copy(values, values + kFeatureCount, features.values.begin());
+    return features;
+}
+
+// Returns the features of the window at (row, col) of a feature map, keyed by feature name
+std::map<std::string, double> BoardTextureScanner::windowFeatures(const cv::Mat& featureMap, int row, int col) {
+    return toFeatureMap(windowFeatureVector(featureMap, row, col));
+}
+
+// Adds (sign = +1) or removes (sign = -1) one pixel pair from the histogram and its running sums
+void BoardTextureScanner::updatePair(int i, int j, int sign) {
+    int& count = cooccurrenceFreq.at<int>(i, j);
+    int old_count = count;
+    count += sign;
+    cooccurrenceSums.updateCell(i, j, old_count, count);
+}
+
+// Adds or removes the pixels of one row of the current window and every pair of the window that touches it
+void BoardTextureScanner::updateRow(int row, int sign) {
+    const uchar* pixels = levelImage.ptr<uchar>(row);
+    const uchar* gray = board.ptr<uchar>(row);
+    for (int col = left; col < left + windowCols; ++col) {
+        intensitySums.update(gray[col], sign);
+
+        // Pairs where this pixel is the reference pixel
+        int neighbor_x = row + dx;
+        int neighbor_y = col + dy;
+        if (neighbor_x >= top && neighbor_x < top + windowRows && neighbor_y >= left && neighbor_y < left + windowCols) {
+            updatePair(pixels[col], levelImage.at<uchar>(neighbor_x, neighbor_y), sign);
+        }
+
+        // Pairs where this pixel is the neighbor; with dx == 0 both pixels lie on this row and were counted above
+        int reference_x = row - dx;
+        int reference_y = col - dy;
+        if (dx != 0 && reference_x >= top && reference_x < top + windowRows && reference_y >= left && reference_y < left + windowCols) {
+            updatePair(levelImage.at<uchar>(reference_x, reference_y), pixels[col], sign);
+        }
+    }
+}
+
+// Adds or removes the pixels of one column of the current window and every pair of the window that touches it
+void BoardTextureScanner::updateColumn(int col, int sign) {
+    for (int row = top; row < top + windowRows; ++row) {
+        uchar value = levelImage.at<uchar>(row, col);
+        intensitySums.update(board.at<uchar>(row, col), sign);
+
+        // Pairs where this pixel is the reference pixel
+        int neighbor_x = row + dx;
+        int neighbor_y = col + dy;
+        if (neighbor_x >= top && neighbor_x < top + windowRows && neighbor_y >= left && neighbor_y < left + windowCols) {
+            updatePair(value, levelImage.at<uchar>(neighbor_x, neighbor_y), sign);
+        }
+
+        // Pairs where this pixel is the neighbor; with dy == 0 both pixels lie on this column and were counted above
+        int reference_x = row - dx;
+        int reference_y = col - dy;
+        if (dy != 0 && reference_x >= top && reference_x < top + windowRows && reference_y >= left && reference_y < left + windowCols) {
+            updatePair(levelImage.at<uchar>(reference_x, reference_y), value, sign);
+        }
+    }
+}
+
+// Builds the histogram and power sums of the window at the board origin from scratch
+void BoardTextureScanner::resetWindow() {
+    cooccurrenceFreq.setTo(cv::Scalar(0));
+    cooccurrenceSums = CooccurrenceSums();
+    intensitySums = IntensitySums();
+    top = 0;
+    left = 0;
+
+    for (int row = 0; row < windowRows; ++row) {
+        for (int col = 0; col < windowCols; ++col) {
+            uchar value = levelImage.at<uchar>(row, col);
+            intensitySums.update(board.at<uchar>(row, col), 1);
+
+            int neighbor_x = row + dx;
+            int neighbor_y = col + dy;
+            if (neighbor_x >= 0 && neighbor_x < windowRows && neighbor_y >= 0 && neighbor_y < windowCols) {
+                updatePair(value, levelImage.at<uchar>(neighbor_x, neighbor_y), 1);
+            }
+        }
+    }
+}
+
+// Slides the window one column to the right: the leaving column is removed before the origin moves,
+// the entering column is added after, so each update only sees pairs inside the window
+void BoardTextureScanner::moveRight() {
+    updateColumn(left, -1);
+    ++left;
+    updateColumn(left + windowCols - 1, 1);
+}
+
+// Slides the window one column to the left
+void BoardTextureScanner::moveLeft() {
+    updateColumn(left + windowCols - 1, -1);
+    --left;
+    updateColumn(left, 1);
+}
+
+// Slides the window one row down
+void BoardTextureScanner::moveDown() {
+    updateRow(top, -1);
+    ++top;
+    updateRow(top + windowRows - 1, 1);
+}
+
+// Writes the statistical and texture features of the current window
+void BoardTextureScanner::writeFeatures(double* out) const {
+    FeatureVector features = makeFeatureVector(intensitySums.toFeatures(), cooccurrenceSums.toFeatures());
+    std::copy(features.values.begin(), features.values.end(), out);
+}
+
+// Scans the board in serpentine order (left to right, down, right to left, ...) so that every
+// window is reached from its predecessor by single-line moves and the histogram is built only once
+cv::Mat BoardTextureScanner::scan() {
+    if (board.empty() || board.type() != CV_8UC1) {
+        std::cerr << "The board image is not an 8-bit grayscale image." << std::endl;
+        return cv::Mat();
+    }
+    if (windowRows <= 0 || windowCols <= 0 || stride <= 0 || windowRows > board.rows || windowCols > board.cols) {
+        std::cerr << "The scan window does not fit the board image." << std::endl;
+        return cv::Mat();
+    }
+
+    // Quantize the whole board once; statistical features still use the original gray values
+    quantizer.fit(board);
+    if (quantizer.isIdentity()) {
+        levelImage = board;
+    }
+    else {
+        quantizer.apply(board, levelImage);
+    }
+
+    int out_rows = (board.rows - windowRows) / stride + 1;
+    int out_cols = (board.cols - windowCols) / stride + 1;
+    cv::Mat featureMap(out_rows, out_cols, CV_64FC(kFeatureCount));
+
+    resetWindow();
+    for (int r = 0; r < out_rows; ++r) {
+        if (r > 0) {
+            for (int k = 0; k < stride; ++k) {
+                moveDown();
+            }
+        }
+
+        bool left_to_right = (r % 2 == 0);
+        for (int step = 0; step < out_cols; ++step) {
+            if (step > 0) {
+                for (int k = 0; k < stride; ++k) {
+                    if (left_to_right) {
+                        moveRight();
+                    }
+                    else {
+                        moveLeft();
+                    }
+                }
+            }
+            int c = left_to_right ? step : out_cols - 1 - step;
+            writeFeatures(featureMap.ptr<double>(r) + c * kFeatureCount);
+        }
+    }
+
+    return featureMap;
+}
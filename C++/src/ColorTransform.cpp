@@ -0,0 +1,77 @@
+#include "ColorTransform.h"
+#include <cstdint>
+#include <iostream>
+
+namespace {
+    // Converts every pixel of a Pixel-typed image with the given per-channel weights, rounding and
+    // saturating back to Pixel; only the first three channels are weighted for Luma
+    template <typename Pixel>
+    void weightChannels(const cv::Mat& src, const double* weights, cv::Mat& dst) {
+        const int channels = src.channels();
+        for (int i = 0; i < src.rows; ++i) {
+            const Pixel* in = src.ptr<Pixel>(i);
+            Pixel* out = dst.ptr<Pixel>(i);
+            for (int j = 0; j < src.cols; ++j) {
+                double value = 0.0;
+                for (int c = 0; c < channels; ++c) {
+                    value += weights[c] * in[j * channels + c];
+                }
+                out[j] = cv::saturate_cast<Pixel>(value);
+            }
+        }
+    }
+}
+
+// Reduces the image to one channel
+bool applyColorTransform(const cv::Mat& src, ColorTransform transform, int channel, cv::Mat& dst) {
+    const int channels = src.channels();
+    if (src.empty() || (src.depth() != CV_8U && src.depth() != CV_16U && src.depth() != CV_32F)) {
+        std::cerr << "Unsupported image type for color transform." << std::endl;
+        dst.release();
+        return false;
+    }
+    if (channels == 1) {
+        dst = src;
+        return true;
+    }
+    if (channels > 4) {
+        std::cerr << "Unsupported number of channels " << channels << "." << std::endl;
+        dst.release();
+        return false;
+    }
+
+    double weights[4] = {};
+    switch (transform) {
+    case ColorTransform::Luma:
+        if (channels < 3) {
+            std::cerr << "Luma needs a BGR image." << std::endl;
+            dst.release();
+            return false;
+        }
+        weights[0] = 0.114;
+        weights[1] = 0.587;
+        weights[2] = 0.299;
+        break;
+    case ColorTransform::Average:
+        for (int c = 0; c < channels; ++c) {
+            weights[c] = 1.0 / channels;
+        }
+        break;
+    case ColorTransform::Channel:
+        if (channel < 0 || channel >= channels) {
+            std::cerr << "Channel " << channel << " is not in the image (" << channels << " channels)." << std::endl;
+            dst.release();
+            return false;
+        }
+        weights[channel] = 1.0;
+        break;
+    }
+
+    dst.create(src.rows, src.cols, CV_MAKETYPE(src.depth(), 1));
+    switch (src.depth()) {
+    case CV_8U: weightChannels<uchar>(src, weights, dst); break;
+    case CV_16U: weightChannels<uint16_t>(src, weights, dst); break;
+    default: weightChannels<float>(src, weights, dst); break;
+    }
+    return true;
+}
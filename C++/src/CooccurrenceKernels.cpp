@@ -0,0 +1,239 @@
+#include "CooccurrenceKernels.h"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define COOCCURRENCE_HAVE_AVX2_DISPATCH 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define COOCCURRENCE_HAVE_NEON 1
+#endif
+
+namespace {
+    constexpr int kMaxCopies = 4;                      // Private histograms per accumulation
+    constexpr size_t kPrivateBudget = 64 * 1024;      // Bytes of histogram copies that still stay in L1/L2
+
+    // Histogram copies for the current thread, kept zeroed between calls
+    thread_local std::vector<int32_t> privateCopies;
+    // Touched-cell lists of the slots, levels x levels + 1 entries per slot (one spare for the
+    // unconditional store of addPair()); the first list also collects the cells raised by a full merge
+    thread_local std::vector<int> touchedCells;
+
+    // One of the kMaxCopies histograms the kernels cycle over, with the list of cells whose count it
+    // raised from zero (tracked accumulation only). With fewer copies than slots, several slots share
+    // one histogram; a cell is then still listed once, by the slot that counted its first pair.
+    struct HistogramSlot {
+        int32_t* counts;
+        int* touched;
+        int touchedCount;
+    };
+
+    // Number of private histograms that fit the cache budget for this level count
+    int copyCount(int levels) {
+        size_t bytes = static_cast<size_t>(levels) * levels * sizeof(int32_t);
+        return static_cast<int>(std::max<size_t>(1, std::min<size_t>(kMaxCopies, kPrivateBudget / bytes)));
+    }
+
+    // Counts one pair. When Tracked, a cell's first pair adds it to the touched list: the cell is always
+    // written past the end of the list and kept only by advancing the count, so there is no branch.
+    template <bool Tracked>
+    inline void addPair(HistogramSlot& slot, int cell) {
+        const int32_t count = slot.counts[cell]++;
+        if (Tracked) {
+            slot.touched[slot.touchedCount] = cell;
+            slot.touchedCount += count == 0;
+        }
+    }
+
+    // Scalar kernel: one row segment of reference pixels a[0..n) and neighbor pixels b[0..n).
+    // The slots are copied to locals so the list lengths stay in registers across the stores.
+    template <bool Tracked>
+    inline void accumulateRowScalar(const uchar* a, const uchar* b, int n, int levels, HistogramSlot* slots) {
+        HistogramSlot s0 = slots[0], s1 = slots[1], s2 = slots[2], s3 = slots[3];
+        int j = 0;
+        for (; j + 4 <= n; j += 4) {
+            addPair<Tracked>(s0, a[j] * levels + b[j]);
+            addPair<Tracked>(s1, a[j + 1] * levels + b[j + 1]);
+            addPair<Tracked>(s2, a[j + 2] * levels + b[j + 2]);
+            addPair<Tracked>(s3, a[j + 3] * levels + b[j + 3]);
+        }
+        for (; j < n; ++j) {
+            addPair<Tracked>(s0, a[j] * levels + b[j]);
+        }
+        slots[0] = s0;
+        slots[1] = s1;
+        slots[2] = s2;
+        slots[3] = s3;
+    }
+
+#if defined(COOCCURRENCE_HAVE_AVX2_DISPATCH)
+    // AVX2 kernel: computes 16 cell indices a * levels + b per step in 16-bit lanes, then scatters them
+    template <bool Tracked>
+    __attribute__((target("avx2")))
+    void accumulateRowAvx2(const uchar* a, const uchar* b, int n, int levels, HistogramSlot* slots) {
+        alignas(32) uint16_t cells[16];
+        const __m256i level_count = _mm256_set1_epi16(static_cast<short>(levels));
+        HistogramSlot s0 = slots[0], s1 = slots[1], s2 = slots[2], s3 = slots[3];
+        int j = 0;
+        for (; j + 16 <= n; j += 16) {
+            __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + j)));
+            __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j)));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(cells), _mm256_add_epi16(_mm256_mullo_epi16(va, level_count), vb));
+            for (int k = 0; k < 16; k += 4) {
+                addPair<Tracked>(s0, cells[k]);
+                addPair<Tracked>(s1, cells[k + 1]);
+                addPair<Tracked>(s2, cells[k + 2]);
+                addPair<Tracked>(s3, cells[k + 3]);
+            }
+        }
+        slots[0] = s0;
+        slots[1] = s1;
+        slots[2] = s2;
+        slots[3] = s3;
+        // The tail call into non-VEX code gets no automatic vzeroupper; without it every later SSE
+        // instruction of the thread pays the AVX-SSE transition penalty
+        _mm256_zeroupper();
+        accumulateRowScalar<Tracked>(a + j, b + j, n - j, levels, slots);
+    }
+
+    bool hasAvx2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+#endif
+
+#if defined(COOCCURRENCE_HAVE_NEON)
+    // NEON kernel: computes 8 cell indices a * levels + b per step in 16-bit lanes, then scatters them
+    template <bool Tracked>
+    void accumulateRowNeon(const uchar* a, const uchar* b, int n, int levels, HistogramSlot* slots) {
+        uint16_t cells[8];
+        HistogramSlot s0 = slots[0], s1 = slots[1], s2 = slots[2], s3 = slots[3];
+        int j = 0;
+        for (; j + 8 <= n; j += 8) {
+            uint16x8_t va = vmovl_u8(vld1_u8(a + j));
+            uint16x8_t vb = vmovl_u8(vld1_u8(b + j));
+            vst1q_u16(cells, vmlaq_n_u16(vb, va, static_cast<uint16_t>(levels)));
+            for (int k = 0; k < 8; k += 4) {
+                addPair<Tracked>(s0, cells[k]);
+                addPair<Tracked>(s1, cells[k + 1]);
+                addPair<Tracked>(s2, cells[k + 2]);
+                addPair<Tracked>(s3, cells[k + 3]);
+            }
+        }
+        slots[0] = s0;
+        slots[1] = s1;
+        slots[2] = s2;
+        slots[3] = s3;
+        accumulateRowScalar<Tracked>(a + j, b + j, n - j, levels, slots);
+    }
+#endif
+
+    // Runs the kernel of the best available instruction set over the in-bounds rows
+    template <bool Tracked>
+    void accumulateRows(const cv::Mat& levelImage, int levels, int dx, int dy, int rowBegin, int rowEnd, int colBegin,
+        int width, HistogramSlot* slots) {
+        for (int i = rowBegin; i < rowEnd; ++i) {
+            const uchar* a = levelImage.ptr<uchar>(i) + colBegin;
+            const uchar* b = levelImage.ptr<uchar>(i + dx) + colBegin + dy;
+#if defined(COOCCURRENCE_HAVE_AVX2_DISPATCH)
+            if (hasAvx2()) {
+                accumulateRowAvx2<Tracked>(a, b, width, levels, slots);
+                continue;
+            }
+#elif defined(COOCCURRENCE_HAVE_NEON)
+            accumulateRowNeon<Tracked>(a, b, width, levels, slots);
+            continue;
+#endif
+            accumulateRowScalar<Tracked>(a, b, width, levels, slots);
+        }
+    }
+}
+
+// Accumulates the pair counts over the in-bounds region of the offset. Which cells turn non-zero is found
+// one of two ways, chosen by which visits fewer cells:
+//  - few pairs for the matrix size: every pair is tracked (addPair<true>), freq takes the pairs of one
+//    slot directly, and only the touched cells of the private copies are merged into freq;
+//  - otherwise: the pairs go to the private copies only, and the merge, which then passes over every
+//    cell of the copies anyway, records each freq cell it raises from zero.
+int64_t accumulateCooccurrence(const cv::Mat& levelImage, int levels, int dx, int dy, int32_t* freq, std::vector<int>& cells) {
+    const int rows = levelImage.rows;
+    const int cols = levelImage.cols;
+
+    // Reference pixels whose neighbor (i + dx, j + dy) is inside the image
+    const int row_begin = std::max(0, -dx);
+    const int row_end = std::min(rows, rows - dx);
+    const int col_begin = std::max(0, -dy);
+    const int col_end = std::min(cols, cols - dy);
+    if (row_begin >= row_end || col_begin >= col_end) {
+        return 0;
+    }
+    const int width = col_end - col_begin;
+    const int64_t pairs = static_cast<int64_t>(row_end - row_begin) * width;
+
+    const int copies = copyCount(levels);
+    const size_t matrix_size = static_cast<size_t>(levels) * levels;
+    const bool tracked = pairs < static_cast<int64_t>(matrix_size);
+    if (privateCopies.size() < copies * matrix_size) {
+        privateCopies.assign(copies * matrix_size, 0);
+    }
+    if (touchedCells.size() < kMaxCopies * (matrix_size + 1)) {
+        touchedCells.resize(kMaxCopies * (matrix_size + 1));
+    }
+    // Slots beyond the copy count reuse the copies in turn, so every copy takes its share of the pairs
+    HistogramSlot slots[kMaxCopies];
+    for (int s = 0; s < kMaxCopies; ++s) {
+        const int copy = s % copies;
+        slots[s].counts = tracked && copy == 0 ? freq : privateCopies.data() + copy * matrix_size;
+        slots[s].touched = tracked ? touchedCells.data() + s * (matrix_size + 1) : nullptr;
+        slots[s].touchedCount = 0;
+    }
+
+    if (!tracked) {
+        accumulateRows<false>(levelImage, levels, dx, dy, row_begin, row_end, col_begin, width, slots);
+        // The copies are summed into the first (a vectorized pass), which is then added to freq. Every cell
+        // is stored past the end of the raised list and kept only when the merge raises it from zero, so
+        // the half-filled matrices of mid-size level counts cost no mispredicted branches.
+        int32_t* merged = privateCopies.data();
+        for (int c = 1; c < copies; ++c) {
+            const int32_t* copy = privateCopies.data() + c * matrix_size;
+            for (size_t cell = 0; cell < matrix_size; ++cell) {
+                merged[cell] += copy[cell];
+            }
+        }
+        int* raised = touchedCells.data();
+        int raised_count = 0;
+        for (size_t cell = 0; cell < matrix_size; ++cell) {
+            const int32_t added = merged[cell];
+            const int32_t before = freq[cell];
+            freq[cell] = before + added;
+            raised[raised_count] = static_cast<int>(cell);
+            raised_count += (before == 0) & (added != 0);
+        }
+        cells.insert(cells.end(), raised, raised + raised_count);
+        std::fill(privateCopies.begin(), privateCopies.begin() + copies * matrix_size, 0);
+        return pairs;
+    }
+
+    accumulateRows<true>(levelImage, levels, dx, dy, row_begin, row_end, col_begin, width, slots);
+    // Cells the slots on freq itself raised from zero, then the touched cells of the private copies:
+    // each is moved into freq, reported if that makes the freq cell non-zero, and cleared for the next call
+    for (int s = 0; s < kMaxCopies; s += copies) {
+        cells.insert(cells.end(), slots[s].touched, slots[s].touched + slots[s].touchedCount);
+    }
+    for (int s = 0; s < kMaxCopies; ++s) {
+        if (s % copies == 0) {
+            continue;
+        }
+        const HistogramSlot& slot = slots[s];
+        for (int t = 0; t < slot.touchedCount; ++t) {
+            const int cell = slot.touched[t];
+            if (freq[cell] == 0) {
+                cells.push_back(cell);
+            }
+            freq[cell] += slot.counts[cell];
+            slot.counts[cell] = 0;
+        }
+    }
+    return pairs;
+}
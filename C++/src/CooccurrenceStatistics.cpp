@@ -0,0 +1,60 @@
+#include "CooccurrenceStatistics.h"
+
+// Converts the running sums into Haralick features.
+// Cluster shade and prominence are the third and fourth central moments of s = i + j,
+// expanded from the raw moments so that no second pass over the matrix is needed.
+HaralickFeatures CooccurrenceSums::toFeatures() const {
+    HaralickFeatures features;
+    if (pairs <= 0) {
+        return features;  // An empty matrix has all features equal to zero
+    }
+
+    const double n = static_cast<double>(pairs);
+    features.mx1 = sumI / n;
+    features.mx2 = sumJ / n;
+
+    const double mu = features.mx1 + features.mx2;  // Mean of s = i + j
+    const double m2 = sumS2 / n;
+    const double m3 = sumS3 / n;
+    const double m4 = static_cast<double>(sumS4) / n;
+    features.clusterShade = m3 - 3.0 * mu * m2 + 2.0 * mu * mu * mu;
+    features.clusterProminence = m4 - 4.0 * mu * m3 + 6.0 * mu * mu * m2 - 3.0 * mu * mu * mu * mu;
+
+    features.localHomogeneity = sumHomogeneity / n;
+    features.energy = sumC2 / (n * n);
+    features.entropy = std::log2(n) - sumCLogC / n;  // -sum(p log2 p) with p = c / n
+    features.inertia = sumD2 / n;
+    return features;
+}
+
+// Adds the cells group by group, so a caller that needs only the power sums never evaluates a logarithm.
+// Within a group the cells are added in list order, which gives the same rounding as addCell().
+void CooccurrenceSums::addCells(const int32_t* freq, const std::vector<int>& cells, int levels, unsigned groups) {
+    if (groups & kPowerSums) {
+        for (int cell : cells) {
+            const int64_t c = freq[cell];
+            const int64_t i = cell / levels;
+            const int64_t j = cell % levels;
+            const int64_t s = i + j;
+            pairs += c;
+            sumI += i * c;
+            sumJ += j * c;
+            sumS2 += s * s * c;
+            sumS3 += s * s * s * c;
+            sumS4 += static_cast<FourthPowerSum>(s * s * s * s) * c;
+            sumD2 += (i - j) * (i - j) * c;
+            sumC2 += c * c;
+        }
+    }
+    if (groups & kHomogeneitySum) {
+        for (int cell : cells) {
+            const int64_t d = cell / levels - cell % levels;
+            sumHomogeneity += static_cast<double>(freq[cell]) / (1 + d * d);
+        }
+    }
+    if (groups & kEntropySum) {
+        for (int cell : cells) {
+            sumCLogC += cLogC(freq[cell]);
+        }
+    }
+}
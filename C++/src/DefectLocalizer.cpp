@@ -0,0 +1,248 @@
+#include "DefectLocalizer.h"
+#include "ExtractionContext.h"
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+namespace {
+    // Union-find over the cells of the map, with union by size and path halving
+    struct DisjointSets {
+        std::vector<int> parent;
+        std::vector<int> size;
+
+        explicit DisjointSets(int count) : parent(count), size(count, 1) {
+            std::iota(parent.begin(), parent.end(), 0);
+        }
+
+        int find(int element) {
+            while (parent[element] != element) {
+                parent[element] = parent[parent[element]];
+                element = parent[element];
+            }
+            return element;
+        }
+
+        void unite(int a, int b) {
+            a = find(a);
+            b = find(b);
+            if (a == b) {
+                return;
+            }
+            if (size[a] < size[b]) {
+                std::swap(a, b);
+            }
+            parent[b] = a;
+            size[a] += size[b];
+        }
+    };
+
+    // Range of map cells covered by a tile
+    struct CellRange {
+        int row0, row1, col0, col1;    // Inclusive
+    };
+
+    CellRange cellRange(const cv::Rect& rect, int cellSize) {
+        return CellRange{ rect.y / cellSize, (rect.y + rect.height - 1) / cellSize,
+            rect.x / cellSize, (rect.x + rect.width - 1) / cellSize };
+    }
+
+    // Writes the label and confidence of a tile into the cells it covers
+    void paintTile(const LocalizedTile& tile, int cellSize, cv::Mat& labels, cv::Mat& confidence) {
+        CellRange cells = cellRange(tile.rect, cellSize);
+        for (int r = cells.row0; r <= cells.row1; ++r) {
+            int* label_row = labels.ptr<int>(r);
+            double* confidence_row = confidence.ptr<double>(r);
+            for (int c = cells.col0; c <= cells.col1; ++c) {
+                label_row[c] = tile.label;
+                confidence_row[c] = tile.confidence;
+            }
+        }
+    }
+
+    // True when a cell just outside the tile is classified with another label, i.e. the tile lies on the
+    // outline of a defect (or between two defect classes)
+    bool onBoundary(const LocalizedTile& tile, int cellSize, const cv::Mat& labels) {
+        CellRange cells = cellRange(tile.rect, cellSize);
+        auto differs = [&](int r, int c) {
+            if (r < 0 || r >= labels.rows || c < 0 || c >= labels.cols) {
+                return false;
+            }
+            int label = labels.ptr<int>(r)[c];
+            return label != kUnclassifiedLabel && label != tile.label;
+        };
+        for (int c = cells.col0; c <= cells.col1; ++c) {
+            if (differs(cells.row0 - 1, c) || differs(cells.row1 + 1, c)) {
+                return true;
+            }
+        }
+        for (int r = cells.row0; r <= cells.row1; ++r) {
+            if (differs(r, cells.col0 - 1) || differs(r, cells.col1 + 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+// Constructor: Validates the tile sizes and finds the cell size, the smallest tile reached by halving
+DefectLocalizer::DefectLocalizer(const BayesianDefectClassifier& Classifier, const LocalizationSettings& Settings)
+    : classifier{ Classifier },
+    settings{ Settings } {
+    if (settings.tileSize < 1) {
+        settings.tileSize = 64;
+    }
+    settings.minTileSize = std::max(1, std::min(settings.minTileSize, settings.tileSize));
+    cellSize = settings.tileSize;
+    while (cellSize % 2 == 0 && cellSize / 2 >= settings.minTileSize) {
+        cellSize /= 2;
+    }
+}
+
+// Classifies every tile: clear wood through the cascade or the clear-area threshold, defects by pairwise voting
+void DefectLocalizer::classifyTiles(const cv::Mat& board, std::vector<LocalizedTile>& tiles, WorkStealingPool& pool) const {
+    pool.parallelFor(tiles.size(), [&](size_t i) {
+        thread_local ExtractionContext context;
+        context.configure(settings.extraction);
+        LocalizedTile& tile = tiles[i];
+        tile.label = kUnclassifiedLabel;
+        tile.confidence = 0.0;
+        if (!context.setPatch(board(tile.rect))) {
+            return;
+        }
+        if (settings.cascade && classifier.passesClearCascade(context.getStatisticalFeatures())) {
+            tile.label = kClearLabel;
+            tile.confidence = 1.0;
+            return;
+        }
+        FeatureVector features = context.getFeatureVector();
+        if (settings.clearThreshold >= 0.0 && classifier.isClearArea(features, settings.clearThreshold)) {
+            tile.label = kClearLabel;
+            tile.confidence = 1.0;
+            return;
+        }
+        tile.label = classifier.predictClassIndex(features, &tile.confidence);
+    });
+}
+
+// Coarse pass over the whole board, then repeated halving of the tiles on label boundaries
+DefectMap DefectLocalizer::localize(const cv::Mat& board, WorkStealingPool& pool) const {
+    DefectMap map;
+    map.boardSize = cv::Size(board.cols, board.rows);
+    map.cellSize = cellSize;
+    if (board.empty() || classifier.classModels.empty()) {
+        std::cerr << "Localization needs a board image and a trained classifier." << std::endl;
+        return map;
+    }
+    map.labels = cv::Mat(cv::Size((board.cols + cellSize - 1) / cellSize, (board.rows + cellSize - 1) / cellSize),
+        CV_32S, cv::Scalar(kUnclassifiedLabel));
+    map.confidence = cv::Mat::zeros(map.labels.rows, map.labels.cols, CV_64F);
+
+    // Coarse tiles; margins narrower than the smallest tile stay unclassified
+    std::vector<LocalizedTile> level;
+    for (int y = 0; y < board.rows; y += settings.tileSize) {
+        for (int x = 0; x < board.cols; x += settings.tileSize) {
+            LocalizedTile tile;
+            tile.rect = cv::Rect(x, y, std::min(settings.tileSize, board.cols - x), std::min(settings.tileSize, board.rows - y));
+            if (tile.rect.width >= settings.minTileSize && tile.rect.height >= settings.minTileSize) {
+                level.push_back(tile);
+            }
+        }
+    }
+
+    int size = settings.tileSize;
+    while (!level.empty()) {
+        classifyTiles(board, level, pool);
+        map.classifiedTiles += level.size();
+        for (const LocalizedTile& tile : level) {
+            paintTile(tile, cellSize, map.labels, map.confidence);
+        }
+
+        // Split the boundary tiles into quarters; tiles inside a uniform area are final
+        std::vector<LocalizedTile> next;
+        const int half = size / 2;
+        for (const LocalizedTile& tile : level) {
+            if (size == cellSize || tile.label == kUnclassifiedLabel || !onBoundary(tile, cellSize, map.labels)) {
+                map.tiles.push_back(tile);
+                continue;
+            }
+            for (int dy = 0; dy < tile.rect.height; dy += half) {
+                for (int dx = 0; dx < tile.rect.width; dx += half) {
+                    LocalizedTile child = tile;
+                    child.rect = cv::Rect(tile.rect.x + dx, tile.rect.y + dy,
+                        std::min(half, tile.rect.width - dx), std::min(half, tile.rect.height - dy));
+                    if (child.rect.width >= settings.minTileSize && child.rect.height >= settings.minTileSize) {
+                        next.push_back(child);
+                    }
+                    else {
+                        map.tiles.push_back(child);  // Too small to classify: keeps the parent's result
+                    }
+                }
+            }
+        }
+        level.swap(next);
+        size = half;
+    }
+
+    std::vector<std::string> names;
+    for (const DefectClassModel& model : classifier.classModels) {
+        names.push_back(model.name);
+    }
+    map.regions = mergeRegions(map.labels, map.confidence, cellSize, map.boardSize, names);
+    return map;
+}
+
+// Unites every defect cell with its left and upper neighbor of the same class, then collects one region per set
+std::vector<DefectRegion> DefectLocalizer::mergeRegions(const cv::Mat& labels, const cv::Mat& confidence, int cellSize,
+    cv::Size boardSize, const std::vector<std::string>& names) {
+    const int rows = labels.rows;
+    const int cols = labels.cols;
+    DisjointSets sets(rows * cols);
+    for (int r = 0; r < rows; ++r) {
+        const int* row = labels.ptr<int>(r);
+        const int* above = r > 0 ? labels.ptr<int>(r - 1) : nullptr;
+        for (int c = 0; c < cols; ++c) {
+            if (row[c] < 0) {
+                continue;
+            }
+            if (c > 0 && row[c - 1] == row[c]) {
+                sets.unite(r * cols + c, r * cols + c - 1);
+            }
+            if (above != nullptr && above[c] == row[c]) {
+                sets.unite(r * cols + c, (r - 1) * cols + c);
+            }
+        }
+    }
+
+    std::vector<DefectRegion> regions;
+    std::vector<int> region_of_root(rows * cols, -1);
+    std::vector<double> weighted_confidence;
+    const cv::Rect board(0, 0, boardSize.width, boardSize.height);
+    for (int r = 0; r < rows; ++r) {
+        const int* row = labels.ptr<int>(r);
+        const double* confidence_row = confidence.ptr<double>(r);
+        for (int c = 0; c < cols; ++c) {
+            if (row[c] < 0) {
+                continue;
+            }
+            int& index = region_of_root[sets.find(r * cols + c)];
+            const cv::Rect cell = cv::Rect(c * cellSize, r * cellSize, cellSize, cellSize) & board;
+            if (index < 0) {
+                index = static_cast<int>(regions.size());
+                DefectRegion region;
+                region.label = row[c];
+                region.name = row[c] < static_cast<int>(names.size()) ? names[row[c]] : std::string();
+                region.box = cell;
+                regions.push_back(region);
+                weighted_confidence.push_back(0.0);
+            }
+            DefectRegion& region = regions[index];
+            region.box |= cell;
+            region.area += cell.area();
+            weighted_confidence[index] += confidence_row[c] * cell.area();
+        }
+    }
+    for (size_t i = 0; i < regions.size(); ++i) {
+        regions[i].confidence = regions[i].area > 0 ? weighted_confidence[i] / regions[i].area : 0.0;
+    }
+    return regions;
+}
@@ -0,0 +1,97 @@
+#include "ExtractionContext.h"
+#include "Instrumentation.h"
+#include <limits>
+
+namespace {
+    bool sameSettings(const ExtractionSettings& a, const ExtractionSettings& b) {
+        return a.angle == b.angle && a.distance == b.distance && a.levels == b.levels && a.mode == b.mode
+            && a.color == b.color && a.channel == b.channel && a.bitDepth == b.bitDepth;
+    }
+}
+
+// Constructor: Sets up the quantizer and the co-occurrence matrix
+ExtractionContext::ExtractionContext(const ExtractionSettings& Settings)
+    : settings{ Settings },
+    quantizer{ Settings.levels, Settings.mode },
+    cooccurrenceMatrix{ cv::Mat::zeros(quantizer.getLevels(), quantizer.getLevels(), CV_32S) } {
+    nonzeroCells.reserve(cooccurrenceMatrix.total());
+}
+
+// Rebuilds the quantizer for new settings; the co-occurrence matrix keeps its buffer when the level count is
+// unchanged. Unchanged settings keep everything, so calling this before every patch is cheap.
+void ExtractionContext::configure(const ExtractionSettings& Settings) {
+    if (sameSettings(settings, Settings)) {
+        return;
+    }
+    settings = Settings;
+    quantizer = GrayLevelQuantizer(settings.levels, settings.mode);
+    quantizerBits = 0;
+    const int levels = quantizer.getLevels();
+    if (cooccurrenceMatrix.rows != levels) {
+        cooccurrenceMatrix = cv::Mat::zeros(levels, levels, CV_32S);
+        nonzeroCells.clear();
+        nonzeroCells.reserve(static_cast<size_t>(levels) * levels);
+    }
+    patch.release();
+    hasPatch = false;
+    hasTexture = false;
+}
+
+// Reduces the image to one channel and computes its statistical features; texture features follow on first use
+bool ExtractionContext::setPatch(const cv::Mat& image) {
+    hasPatch = false;
+    hasTexture = false;
+    patch.release();  // Drop the view of the previous patch before channelBuffer may be written
+    if (!reduceToFeatureChannel(image, settings, channelBuffer, patch)) {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        statistics.mean = statistics.variance = statistics.skewness = statistics.kurtosis = nan;
+        return false;
+    }
+
+    // The quantizer is rebuilt only when the input range changes
+    const int bits = significantBits(settings, patch.depth());
+    if (bits != quantizerBits) {
+        quantizer = makeQuantizer(settings, bits);
+        quantizerBits = bits;
+    }
+
+    LUMBER_SCOPED_TIMER(Metric::StatisticalFeatures);
+    LUMBER_RECORD_METRIC(Metric::PatchPixels, patch.total());
+    statistics = computeStatisticalFeatures(patch);
+    hasPatch = true;
+    return true;
+}
+
+// Quantizes the current patch into the reused buffer and accumulates its co-occurrence matrix in place
+const HaralickFeatures& ExtractionContext::getTextureFeatures() {
+    if (hasTexture || !hasPatch) {
+        return texture;
+    }
+
+    const cv::Mat& levels_image = quantizePatch(quantizer, patch, quantizedBuffer);
+    CooccurrenceOffset offset{ settings.angle, settings.distance };
+    countCooccurrences(levels_image, offset.rowShift(), offset.colShift(), cooccurrenceMatrix, nonzeroCells);
+
+    LUMBER_SCOPED_TIMER(Metric::TextureSums);
+    CooccurrenceSums sums;
+    sums.addCells(cooccurrenceMatrix.ptr<int>(), nonzeroCells, cooccurrenceMatrix.rows, kAllSums);
+    texture = sums.toFeatures();
+    hasTexture = true;
+    return texture;
+}
+
+// Combines the statistical and texture features of the current patch
+FeatureVector ExtractionContext::getFeatureVector() {
+    FeatureVector features;
+    if (!hasPatch) {
+        features.values.fill(std::numeric_limits<double>::quiet_NaN());
+        return features;
+    }
+    return makeFeatureVector(statistics, getTextureFeatures());
+}
+
+// Extracts all features of one patch
+FeatureVector ExtractionContext::extract(const cv::Mat& image) {
+    setPatch(image);
+    return getFeatureVector();
+}
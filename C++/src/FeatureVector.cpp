@@ -0,0 +1,80 @@
+#include "FeatureVector.h"
+#include "CooccurrenceStatistics.h"
+#include "IntensityStatistics.h"
+#include <limits>
+
+// Names of the features in FeatureVector order
+const std::vector<std::string>& featureNames() {
+    static const std::vector<std::string> names = {
+        "mean", "variance", "skewness", "kurtosis", "inertia",
+        "cluster_shade", "cluster_prominence", "local_homogeneity", "energy", "entropy" };
+    return names;
+}
+
+// Index of a feature name in FeatureVector order, or -1 if the name is unknown
+int featureIndex(const std::string& name) {
+    const std::vector<std::string>& names = featureNames();
+    for (int k = 0; k < kFeatureCount; ++k) {
+        if (names[k] == name) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+// Converts a string-keyed feature map into a FeatureVector
+FeatureVector toFeatureVector(const std::map<std::string, double>& features, const std::vector<std::string>& required) {
+    for (const auto& name : required) {
+        features.at(name);  // Same failure as a direct lookup of a missing feature
+    }
+
+    FeatureVector vector;
+    vector.values.fill(std::numeric_limits<double>::quiet_NaN());
+    for (const auto& entry : features) {
+        int index = featureIndex(entry.first);
+        if (index >= 0) {
+            vector[index] = entry.second;
+        }
+    }
+    return vector;
+}
+
+// Converts a FeatureVector into a string-keyed feature map
+std::map<std::string, double> toFeatureMap(const FeatureVector& features) {
+    std::map<std::string, double> map;
+    for (int k = 0; k < kFeatureCount; ++k) {
+        map[featureNames()[k]] = features[k];
+    }
+    return map;
+}
+
+// Assembles a FeatureVector from the statistical and texture features
+FeatureVector makeFeatureVector(const StatisticalFeatures& statistics, const HaralickFeatures& texture) {
+    FeatureVector features;
+    setStatisticalFeatures(features, statistics);
+    features[Feature::Inertia] = texture.inertia;
+    features[Feature::ClusterShade] = texture.clusterShade;
+    features[Feature::ClusterProminence] = texture.clusterProminence;
+    features[Feature::LocalHomogeneity] = texture.localHomogeneity;
+    features[Feature::Energy] = texture.energy;
+    features[Feature::Entropy] = texture.entropy;
+    return features;
+}
+
+// Writes mean, variance, skewness and kurtosis into their slots
+void setStatisticalFeatures(FeatureVector& features, const StatisticalFeatures& statistics) {
+    features[Feature::Mean] = statistics.mean;
+    features[Feature::Variance] = statistics.variance;
+    features[Feature::Skewness] = statistics.skewness;
+    features[Feature::Kurtosis] = statistics.kurtosis;
+}
+
+// Reads mean, variance, skewness and kurtosis from their slots
+StatisticalFeatures toStatisticalFeatures(const FeatureVector& features) {
+    StatisticalFeatures statistics;
+    statistics.mean = features[Feature::Mean];
+    statistics.variance = features[Feature::Variance];
+    statistics.skewness = features[Feature::Skewness];
+    statistics.kurtosis = features[Feature::Kurtosis];
+    return statistics;
+}
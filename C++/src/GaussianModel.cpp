@@ -0,0 +1,106 @@
+#include "GaussianModel.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+namespace {
+    const double kLog2Pi = std::log(2.0 * 3.14159265358979323846);
+    constexpr size_t kBlockSize = 64;  // Regions scored together by logLikelihoods()
+}
+
+// Constructor: Restricts the statistics to the selected features and computes the Cholesky factor
+GaussianModel::GaussianModel(const std::vector<int>& Features, const FeatureVector& Mean, const double* Covariance, const FeatureVector& Ridge)
+    : features{ Features }
+{
+    const int m = dimension();
+    mean.resize(m);
+    cholesky.assign(static_cast<size_t>(m) * m, 0.0);
+    inverseDiagonal.assign(m, 0.0);
+
+    for (int a = 0; a < m; ++a) {
+        mean[a] = Mean[features[a]];
+    }
+
+    // Cholesky-Banachiewicz factorization of the restricted covariance
+    double log_det = 0.0;
+    for (int a = 0; a < m; ++a) {
+        for (int b = 0; b <= a; ++b) {
+            double sum = Covariance[features[a] * kFeatureCount + features[b]];
+            if (a == b) {
+                sum += Ridge[features[a]];
+            }
+            for (int k = 0; k < b; ++k) {
+                sum -= cholesky[a * m + k] * cholesky[b * m + k];
+            }
+
+            if (a == b) {
+                // Guard against a covariance that is singular despite the ridge
+                double pivot = sum > 0.0 ? sum : std::numeric_limits<double>::min() * 1e10;
+                cholesky[a * m + a] = std::sqrt(pivot);
+                inverseDiagonal[a] = 1.0 / cholesky[a * m + a];
+                log_det += std::log(pivot);
+            }
+            else {
+                cholesky[a * m + b] = sum / cholesky[b * m + b];
+            }
+        }
+    }
+
+    logNormalizer = -0.5 * (m * kLog2Pi + log_det);
+}
+
+// Log density: forward substitution L z = x - mean, then -0.5 * |z|^2 plus the normalizer. The operations per
+// region are those of logLikelihoods(), in the same order, so both give the same value.
+double GaussianModel::logLikelihood(const FeatureVector& x) const
+{
+    const int m = dimension();
+    double z[kFeatureCount];
+    double squared_norm = 0.0;
+
+    for (int a = 0; a < m; ++a) {
+        double sum = x[features[a]] - mean[a];
+        for (int k = 0; k < a; ++k) {
+            sum -= cholesky[a * m + k] * z[k];
+        }
+        z[a] = sum * inverseDiagonal[a];
+        squared_norm += z[a] * z[a];
+    }
+
+    return logNormalizer - 0.5 * squared_norm;
+}
+
+// Batch log densities: the selected features of a block of regions are gathered into a
+// feature-major layout so each step of the forward substitution is a contiguous loop over regions
+void GaussianModel::logLikelihoods(const FeatureVector* regions, size_t count, double* out) const
+{
+    const int m = dimension();
+    double z[kFeatureCount][kBlockSize];
+    double squared_norm[kBlockSize];
+
+    for (size_t start = 0; start < count; start += kBlockSize) {
+        const size_t block = std::min(kBlockSize, count - start);
+        std::fill(squared_norm, squared_norm + block, 0.0);
+
+        for (int a = 0; a < m; ++a) {
+            const int feature = features[a];
+            for (size_t r = 0; r < block; ++r) {
+                z[a][r] = regions[start + r][feature] - mean[a];
+            }
+            for (int k = 0; k < a; ++k) {
+                const double l = cholesky[a * m + k];
+                for (size_t r = 0; r < block; ++r) {
+                    z[a][r] -= l * z[k][r];
+                }
+            }
+            const double inverse_diagonal = inverseDiagonal[a];
+            for (size_t r = 0; r < block; ++r) {
+                z[a][r] *= inverse_diagonal;
+                squared_norm[r] += z[a][r] * z[a][r];
+            }
+        }
+
+        for (size_t r = 0; r < block; ++r) {
+            out[start + r] = logNormalizer - 0.5 * squared_norm[r];
+        }
+    }
+}
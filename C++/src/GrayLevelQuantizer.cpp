@@ -0,0 +1,203 @@
+#include "GrayLevelQuantizer.h"
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+    // Upper end of the default input range of a pixel type
+    double defaultRangeHigh(int depth) {
+        switch (depth) {
+        case CV_16U: return 65536.0;
+        case CV_32F: return 1.0;
+        default: return 256.0;
+        }
+    }
+
+    // Bin of value among bins equal-width bins starting at low; NaN and values below low go to bin 0
+    template <int Bins, typename Pixel>
+    inline int uniformBin(Pixel value, double low, double scale, int bins) {
+        const int count = Bins > 0 ? Bins : bins;
+        double position = (static_cast<double>(value) - low) * scale;
+        if (!(position > 0.0)) {
+            return 0;
+        }
+        return position >= count - 1 ? count - 1 : static_cast<int>(position);
+    }
+
+    // Quantizes a single-channel image of Pixel values. Bins is a compile-time bin count (0: use bins),
+    // which turns the clamp into a constant; with fineLookup the bins are fine bins mapped through it.
+    template <typename Pixel, int Bins>
+    void quantizeRows(const cv::Mat& src, cv::Mat& dst, double low, double high, int bins, const uchar* fineLookup) {
+        const int count = Bins > 0 ? Bins : bins;
+        const double scale = count / (high - low);
+        for (int i = 0; i < src.rows; ++i) {
+            const Pixel* in = src.ptr<Pixel>(i);
+            uchar* out = dst.ptr<uchar>(i);
+            if (fineLookup != nullptr) {
+                for (int j = 0; j < src.cols; ++j) {
+                    out[j] = fineLookup[uniformBin<Bins>(in[j], low, scale, bins)];
+                }
+            }
+            else {
+                for (int j = 0; j < src.cols; ++j) {
+                    out[j] = static_cast<uchar>(uniformBin<Bins>(in[j], low, scale, bins));
+                }
+            }
+        }
+    }
+
+    // Dispatches once per image to the kernel specialized for the level count
+    template <typename Pixel>
+    void quantizeUniform(const cv::Mat& src, cv::Mat& dst, double low, double high, int levels) {
+        switch (levels) {
+        case 8: quantizeRows<Pixel, 8>(src, dst, low, high, levels, nullptr); break;
+        case 16: quantizeRows<Pixel, 16>(src, dst, low, high, levels, nullptr); break;
+        case 32: quantizeRows<Pixel, 32>(src, dst, low, high, levels, nullptr); break;
+        case 64: quantizeRows<Pixel, 64>(src, dst, low, high, levels, nullptr); break;
+        case 128: quantizeRows<Pixel, 128>(src, dst, low, high, levels, nullptr); break;
+        case 256: quantizeRows<Pixel, 256>(src, dst, low, high, levels, nullptr); break;
+        default: quantizeRows<Pixel, 0>(src, dst, low, high, levels, nullptr); break;
+        }
+    }
+
+    // Histogram of an image over the fine bins of [low, high)
+    template <typename Pixel>
+    void fineHistogram(const cv::Mat& image, double low, double high, long long* histogram) {
+        const int bins = GrayLevelQuantizer::kFineBins;
+        const double scale = bins / (high - low);
+        for (int i = 0; i < image.rows; ++i) {
+            const Pixel* pixels = image.ptr<Pixel>(i);
+            for (int j = 0; j < image.cols; ++j) {
+                ++histogram[uniformBin<GrayLevelQuantizer::kFineBins>(pixels[j], low, scale, bins)];
+            }
+        }
+    }
+
+    // Output level of every histogram bin, placing the bin edges at the quantiles of the histogram
+    template <typename Histogram>
+    void equalize(const Histogram& histogram, size_t bins, int levels, uchar* levelOfBin) {
+        long long total = 0;
+        for (size_t b = 0; b < bins; ++b) {
+            total += histogram[b];
+        }
+        if (total == 0) {
+            return;
+        }
+        long long below = 0;  // Number of pixels in lower bins
+        for (size_t b = 0; b < bins; ++b) {
+            levelOfBin[b] = static_cast<uchar>(std::min<long long>(levels - 1, below * levels / total));
+            below += histogram[b];
+        }
+    }
+}
+
+// Constructor: Validates the level count and fills the uniform lookup table
+GrayLevelQuantizer::GrayLevelQuantizer(int Levels, QuantizationMode Mode)
+    : levels{ Levels },
+    mode{ Mode } {
+
+    if (levels < 2 || levels > 256) {
+        std::cerr << "Unsupported number of gray levels " << levels << ", using 256." << std::endl;
+        levels = 256;
+    }
+    buildUniformLookup();
+}
+
+// Equal-width bins over the input range for 8-bit values; the default range keeps exact integer bin edges
+void GrayLevelQuantizer::buildUniformLookup() {
+    const double scale = levels / (rangeHigh - rangeLow);
+    for (int value = 0; value < 256; ++value) {
+        lookup[value] = customRange ? static_cast<uchar>(uniformBin<0>(value, rangeLow, scale, levels))
+            : static_cast<uchar>(value * levels / 256);
+    }
+}
+
+// Restricts the input values mapped onto the levels
+void GrayLevelQuantizer::setInputRange(double Low, double High) {
+    if (!(High > Low)) {
+        std::cerr << "Empty input range [" << Low << ", " << High << "), keeping the previous range." << std::endl;
+        return;
+    }
+    customRange = true;
+    rangeLow = Low;
+    rangeHigh = High;
+    buildUniformLookup();
+}
+
+// Adopts the pixel type of the image. Equalized mode places the bin edges at the quantiles of the image
+// histogram, so each level holds about the same number of pixels; 16-bit and float images are histogrammed
+// over kFineBins fine bins of the input range.
+void GrayLevelQuantizer::fit(const cv::Mat& image) {
+    if (image.empty()) {
+        return;
+    }
+    if (image.depth() != depth) {
+        depth = image.depth();
+        if (!customRange) {
+            rangeLow = 0.0;
+            rangeHigh = defaultRangeHigh(depth);
+        }
+    }
+    if (mode != QuantizationMode::Equalized) {
+        return;
+    }
+
+    if (depth == CV_8U) {
+        std::array<long long, 256> histogram{};
+        for (int i = 0; i < image.rows; ++i) {
+            const uchar* pixels = image.ptr<uchar>(i);
+            for (int j = 0; j < image.cols; ++j) {
+                ++histogram[pixels[j]];
+            }
+        }
+        equalize(histogram, histogram.size(), levels, lookup.data());
+        return;
+    }
+
+    std::array<long long, kFineBins> histogram{};  // On the stack, so refitting a reused quantizer does not allocate
+    if (depth == CV_16U) {
+        fineHistogram<uint16_t>(image, rangeLow, rangeHigh, histogram.data());
+    }
+    else if (depth == CV_32F) {
+        fineHistogram<float>(image, rangeLow, rangeHigh, histogram.data());
+    }
+    fineLookup.assign(kFineBins, 0);
+    equalize(histogram, histogram.size(), levels, fineLookup.data());
+}
+
+// Quantizes every pixel: through the lookup table for 8-bit images, through the specialized kernels otherwise
+void GrayLevelQuantizer::apply(const cv::Mat& src, cv::Mat& dst) const {
+    dst.create(src.rows, src.cols, CV_8UC1);
+    const bool equalized = mode == QuantizationMode::Equalized && !fineLookup.empty();
+    switch (src.depth()) {
+    case CV_8U:
+        for (int i = 0; i < src.rows; ++i) {
+            const uchar* in = src.ptr<uchar>(i);
+            uchar* out = dst.ptr<uchar>(i);
+            for (int j = 0; j < src.cols; ++j) {
+                out[j] = lookup[in[j]];
+            }
+        }
+        break;
+    case CV_16U:
+        if (equalized) {
+            quantizeRows<uint16_t, kFineBins>(src, dst, rangeLow, rangeHigh, kFineBins, fineLookup.data());
+        }
+        else {
+            quantizeUniform<uint16_t>(src, dst, rangeLow, rangeHigh, levels);
+        }
+        break;
+    case CV_32F:
+        if (equalized) {
+            quantizeRows<float, kFineBins>(src, dst, rangeLow, rangeHigh, kFineBins, fineLookup.data());
+        }
+        else {
+            quantizeUniform<float>(src, dst, rangeLow, rangeHigh, levels);
+        }
+        break;
+    default:
+        std::cerr << "Unsupported pixel type for gray-level quantization." << std::endl;
+        dst.setTo(cv::Scalar(0));
+        break;
+    }
+}
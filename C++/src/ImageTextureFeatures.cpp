@@ -1,26 +1,207 @@
 #include "ImageTextureFeatures.h"
+#include "CooccurrenceKernels.h"
+#include "ExtractionContext.h"
+#include "Instrumentation.h"
+#include <algorithm>
 #include <iostream>
 #include <cmath>
+#include <limits>
+#include <utility>
+
+namespace {
+    // Extraction settings of the positional constructor
+    ExtractionSettings positionalSettings(double Angle, double Distance, int Levels, QuantizationMode Mode) {
+        ExtractionSettings settings;
+        settings.angle = Angle;
+        settings.distance = Distance;
+        settings.levels = Levels;
+        settings.mode = Mode;
+        return settings;
+    }
+}
+
+// Single-channel images are used as they are; others are reduced by the color transform
+bool reduceToFeatureChannel(const cv::Mat& image, const ExtractionSettings& settings, cv::Mat& buffer, cv::Mat& patch) {
+    if (image.channels() == 1) {
+        patch = image;
+    }
+    else if (applyColorTransform(image, settings.color, settings.channel, buffer)) {
+        patch = buffer;
+    }
+    else {
+        patch.release();
+    }
+
+    const int depth = patch.depth();
+    if (patch.empty() || patch.channels() != 1 || (depth != CV_8U && depth != CV_16U && depth != CV_32F)) {
+        std::cerr << "The input image is not an 8-bit, 16-bit or float image with one channel." << std::endl;
+        patch.release();
+        return false;
+    }
+    return true;
+}
+
+// Integer images whose sensor fills only the low bits are quantized over those bits
+int significantBits(const ExtractionSettings& settings, int depth) {
+    const int type_bits = depth == CV_8U ? 8 : 16;
+    return settings.bitDepth > 0 && settings.bitDepth < type_bits && depth != CV_32F ? settings.bitDepth : 0;
+}
+
+// Quantizer of the settings' levels and mode over the given input bits
+GrayLevelQuantizer makeQuantizer(const ExtractionSettings& settings, int bits) {
+    GrayLevelQuantizer quantizer(settings.levels, settings.mode);
+    if (bits > 0) {
+        quantizer.setInputRange(0.0, static_cast<double>(1 << bits));
+    }
+    return quantizer;
+}
+
+// The 256-level uniform case of 8-bit patches uses the patch as is
+const cv::Mat& quantizePatch(GrayLevelQuantizer& quantizer, const cv::Mat& patch, cv::Mat& buffer) {
+    LUMBER_SCOPED_TIMER(Metric::Quantization);
+    quantizer.fit(patch);
+    if (quantizer.isIdentity()) {
+        return patch;
+    }
+    quantizer.apply(patch, buffer);
+    return buffer;
+}
+
+// Resets only the cells filled by the previous offset instead of reallocating the matrix, then runs the
+// branch-free vectorized accumulation over the pixels whose neighbor is within bounds
+void countCooccurrences(const cv::Mat& levelImage, int dx, int dy, cv::Mat& matrix, std::vector<int>& nonzeroCells) {
+    LUMBER_SCOPED_TIMER(Metric::CooccurrenceMatrix);
+    const int num_levels = matrix.rows;
+    int* cooccurrence_freq = matrix.ptr<int>();
+    for (int cell : nonzeroCells) {
+        cooccurrence_freq[cell] = 0;
+    }
+    nonzeroCells.clear();
+    accumulateCooccurrence(levelImage, num_levels, dx, dy, cooccurrence_freq, nonzeroCells);
+    LUMBER_RECORD_METRIC(Metric::NonzeroCells, nonzeroCells.size());
+}
 
 // Constructor: Initializes the image section, angle, distance, and region name
-ImageTextureFeatures::ImageTextureFeatures(const cv::Mat& Image, const std::string& RegionName, double Angle, double Distance)
-    : imageSection{ Image },
-    cooccurrenceMatrix{ cv::Mat::zeros(256, 256, CV_64FC1) },  // Assuming 256 gray levels for 8-bit image
-    angle{ Angle },
-    distance{ Distance },
+ImageTextureFeatures::ImageTextureFeatures(const cv::Mat& Image, const std::string& RegionName, double Angle, double Distance,
+    int Levels, QuantizationMode Mode)
+    : ImageTextureFeatures(Image, RegionName, positionalSettings(Angle, Distance, Levels, Mode)) {
+}
+
+// Constructor: Reduces the image to one channel and sets up the quantizer for its pixel type
+ImageTextureFeatures::ImageTextureFeatures(const cv::Mat& Image, const std::string& RegionName, const ExtractionSettings& Settings)
+    : angle{ Settings.angle },
+    distance{ Settings.distance },
     regionName{ RegionName } {
 
-    // Check if the input image is grayscale
-    if (imageSection.channels() != 1) {
-        std::cerr << "The input image is not a grayscale image." << std::endl;
+    if (reduceToFeatureChannel(Image, Settings, imageSection, imageSection)) {
+        quantizer = makeQuantizer(Settings, significantBits(Settings, imageSection.depth()));
+        calculateStatisticalFeatures();  // Texture features follow lazily on first use
     }
     else {
-        calculateMean();
-        calculateVariance();
-        calculateSkewness();
-        calculateKurtosis();
-        calculateTextureFeatures();
+        quantizer = makeQuantizer(Settings, 0);  // Keeps getLevels() meaningful for rejected input
+    }
+}
+
+// The constructor leaves the image section empty unless it is one channel of 8-bit, 16-bit or float pixels
+bool ImageTextureFeatures::isSupportedSection() const {
+    return !imageSection.empty();
+}
+
+// Quantizes the image section once
+void ImageTextureFeatures::prepareQuantizedSection() const {
+    if (!quantizedSection.empty() || !isSupportedSection()) {
+        return;
+    }
+    quantizedSection = quantizePatch(quantizer, imageSection, quantizedSection);
+}
+
+// Fills cooccurrenceMatrix and nonzeroCells with the pair counts of offset (dx, dy). Only the matrix of the
+// most recent offset is kept; memoized features of earlier offsets live in textureCache.
+void ImageTextureFeatures::buildCooccurrenceMatrix(int dx, int dy) const {
+    if (hasMatrix && matrixDx == dx && matrixDy == dy) {
+        return;
+    }
+    prepareQuantizedSection();
+    if (cooccurrenceMatrix.empty()) {
+        const int num_levels = quantizer.getLevels();
+        cooccurrenceMatrix = cv::Mat::zeros(num_levels, num_levels, CV_32S);  // Allocated on the first texture feature
+    }
+    countCooccurrences(quantizedSection, dx, dy, cooccurrenceMatrix, nonzeroCells);
+    hasMatrix = true;
+    matrixDx = dx;
+    matrixDy = dy;
+}
+
+// Finds the cache entry of an offset. Offsets are keyed by their pixel displacement, so angles and
+// distances that round to the same displacement share one entry.
+ImageTextureFeatures::TextureCacheEntry& ImageTextureFeatures::cacheEntry(int dx, int dy) const {
+    for (TextureCacheEntry& entry : textureCache) {
+        if (entry.dx == dx && entry.dy == dy) {
+            return entry;
+        }
+    }
+    if (textureCache.size() >= kMaxCachedOffsets) {
+        textureCache.erase(textureCache.begin());
+    }
+    textureCache.emplace_back();
+    textureCache.back().dx = dx;
+    textureCache.back().dy = dy;
+    return textureCache.back();
+}
+
+// Sum groups each texture feature depends on
+static unsigned requiredSumGroups(Feature feature) {
+    switch (feature) {
+    case Feature::LocalHomogeneity: return kPowerSums | kHomogeneitySum;
+    case Feature::Entropy: return kPowerSums | kEntropySum;
+    default: return kPowerSums;
+    }
+}
+
+// Returns the cache entry of the current offset with at least the given sum groups. The co-occurrence
+// matrix is built once for the offset and only the missing groups are gathered from it.
+ImageTextureFeatures::TextureCacheEntry& ImageTextureFeatures::gatherSums(unsigned groups) const {
+    CooccurrenceOffset offset{ angle, distance };
+    TextureCacheEntry& entry = cacheEntry(offset.rowShift(), offset.colShift());
+    const unsigned missing = groups & ~entry.sumGroups;
+    if (missing) {
+        buildCooccurrenceMatrix(entry.dx, entry.dy);
+        LUMBER_SCOPED_TIMER(Metric::TextureSums);
+        entry.sums.addCells(cooccurrenceMatrix.ptr<int>(), nonzeroCells, cooccurrenceMatrix.rows, missing);
+        entry.sumGroups |= missing;
     }
+    return entry;
+}
+
+// Returns the memoized texture feature of the current offset. On a miss, only the sum groups the feature
+// needs are gathered; every feature those sums now cover is memoized together, since deriving it from
+// the sums is O(1).
+double ImageTextureFeatures::textureFeature(Feature feature) const {
+    if (!isSupportedSection()) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    TextureCacheEntry& entry = gatherSums(requiredSumGroups(feature));  // No work for a memoized feature
+    if (entry.validFeatures & (1u << static_cast<int>(feature))) {
+        return entry.values[feature];
+    }
+
+    HaralickFeatures features = entry.sums.toFeatures();
+    const std::pair<Feature, double> derived[] = {
+        { Feature::Inertia, features.inertia },
+        { Feature::ClusterShade, features.clusterShade },
+        { Feature::ClusterProminence, features.clusterProminence },
+        { Feature::LocalHomogeneity, features.localHomogeneity },
+        { Feature::Energy, features.energy },
+        { Feature::Entropy, features.entropy },
+    };
+    for (const auto& value : derived) {
+        if ((requiredSumGroups(value.first) & ~entry.sumGroups) == 0) {
+            entry.values[value.first] = value.second;
+            entry.validFeatures |= 1u << static_cast<int>(value.first);
+        }
+    }
+    return entry.values[feature];
 }
 
 // Getters for statistical and texture features
@@ -28,212 +209,325 @@ double ImageTextureFeatures::getMean() const { return mean; }
 double ImageTextureFeatures::getVariance() const { return variance; }
 double ImageTextureFeatures::getSkewness() const { return skewness; }
 double ImageTextureFeatures::getKurtosis() const { return kurtosis; }
-double ImageTextureFeatures::getClusterShade() const { return clusterShade; }
-double ImageTextureFeatures::getClusterProminence() const { return clusterProminence; }
-double ImageTextureFeatures::getLocalHomogeneity() const { return localHomogeneity; }
-double ImageTextureFeatures::getEnergy() const { return energy; }
-double ImageTextureFeatures::getEntropy() const { return entropy; }
-double ImageTextureFeatures::getInertia() const { return inertia; }
-
-// Sets the angle and distance for co-occurrence matrix calculation and recalculates texture features
+double ImageTextureFeatures::getClusterShade() const { return textureFeature(Feature::ClusterShade); }
+double ImageTextureFeatures::getClusterProminence() const { return textureFeature(Feature::ClusterProminence); }
+double ImageTextureFeatures::getLocalHomogeneity() const { return textureFeature(Feature::LocalHomogeneity); }
+double ImageTextureFeatures::getEnergy() const { return textureFeature(Feature::Energy); }
+double ImageTextureFeatures::getEntropy() const { return textureFeature(Feature::Entropy); }
+double ImageTextureFeatures::getInertia() const { return textureFeature(Feature::Inertia); }
+StatisticalFeatures ImageTextureFeatures::getStatisticalFeatures() const {
+    StatisticalFeatures stats;
+    stats.mean = mean;
+    stats.variance = variance;
+    stats.skewness = skewness;
+    stats.kurtosis = kurtosis;
+    return stats;
+}
+FeatureVector ImageTextureFeatures::getFeatureVector() const {
+    FeatureVector features;
+    setStatisticalFeatures(features, getStatisticalFeatures());
+    for (int k = static_cast<int>(Feature::Inertia); k < kFeatureCount; ++k) {
+        features[k] = textureFeature(static_cast<Feature>(k));
+    }
+    return features;
+}
+bool ImageTextureFeatures::hasTextureFeatures() const {
+    CooccurrenceOffset offset{ angle, distance };
+    const unsigned all_texture = (1u << kFeatureCount) - (1u << static_cast<int>(Feature::Inertia));
+    for (const TextureCacheEntry& entry : textureCache) {
+        if (entry.dx == offset.rowShift() && entry.dy == offset.colShift()) {
+            return (entry.validFeatures & all_texture) == all_texture;
+        }
+    }
+    return false;
+}
+int ImageTextureFeatures::getLevels() const { return quantizer.getLevels(); }
+
+// Sets the angle and distance for co-occurrence matrix calculation; features are computed on next use,
+// or read from the cache when the offset was seen before
 void ImageTextureFeatures::setAngleandDistance(double Angle, double Distance) {
     angle = Angle;
     distance = Distance;
-    calculateTextureFeatures();
 }
 
 // Calculates the mean of the pixel values in the image section
 void ImageTextureFeatures::calculateMean() {
-    cv::Scalar meanValue = cv::mean(imageSection);  // OpenCV's mean function computes the mean of each channel
-    mean = meanValue[0];  // Since it's a grayscale image, meanValue[0] will hold the mean
+    mean = computeStatisticalFeatures(imageSection).mean;
 }
 
 // Calculates the variance of the pixel values
 void ImageTextureFeatures::calculateVariance() {
-    cv::Mat temp;
-    cv::pow(imageSection - mean, 2, temp);  // Compute squared difference from mean
-    cv::Scalar varianceValue = cv::mean(temp);  // Compute the mean of squared differences
-    variance = varianceValue[0];  // Variance is the mean of squared differences
+    variance = computeStatisticalFeatures(imageSection).variance;
 }
 
 // Calculates the skewness of the pixel values
 void ImageTextureFeatures::calculateSkewness() {
-    cv::Mat temp;
-    cv::pow(imageSection - mean, 3, temp);  // Compute cubed difference from mean
-    cv::Scalar meanCubedDiff = cv::mean(temp);  // Compute the mean of cubed differences
-    skewness = meanCubedDiff[0] / std::pow(variance, 1.5);  // Skewness formula
+    skewness = computeStatisticalFeatures(imageSection).skewness;
 }
 
 // Calculates the kurtosis of the pixel values
 void ImageTextureFeatures::calculateKurtosis() {
-    cv::Mat temp;
-    cv::pow(imageSection - mean, 4, temp);  // Compute fourth power difference from mean
-    cv::Scalar meanFourthDiff = cv::mean(temp);  // Compute the mean of fourth power differences
-    kurtosis = meanFourthDiff[0] / (variance * variance);  // Kurtosis formula
+    kurtosis = computeStatisticalFeatures(imageSection).kurtosis;
 }
 
-// Calculates the co-occurrence matrix based on the given angle and distance
-void ImageTextureFeatures::calculateCooccurrenceMatrix() {
-    int rows = imageSection.rows;
-    int cols = imageSection.cols;
-    int num_levels = 256;  // Assuming 256 gray levels (8-bit grayscale)
-    cv::Mat cooccurrence_freq = cv::Mat::zeros(num_levels, num_levels, CV_32S);
+// Calculates mean, variance, skewness and kurtosis together in a single pass over the image section
+void ImageTextureFeatures::calculateStatisticalFeatures() {
+    LUMBER_SCOPED_TIMER(Metric::StatisticalFeatures);
+    LUMBER_RECORD_METRIC(Metric::PatchPixels, imageSection.total());
+    StatisticalFeatures stats = computeStatisticalFeatures(imageSection);
+    mean = stats.mean;
+    variance = stats.variance;
+    skewness = stats.skewness;
+    kurtosis = stats.kurtosis;
+}
+
+// Fills the statistical features; Mx1 and Mx2 of the co-occurrence matrix come from calculateMultiOffsetFeatures()
+void ImageTextureFeatures::calculateMoments() {
+    calculateStatisticalFeatures();
+}
 
-    float angle_rad = angle * CV_PI / 180.0f;  // Convert angle to radians
-    int dx = static_cast<int>(round(distance * cos(angle_rad)));  // Calculate displacement in x
-    int dy = static_cast<int>(round(distance * sin(angle_rad)));  // Calculate displacement in y
+// Calculates the co-occurrence matrix based on the given angle and distance and gathers every sum the
+// texture features depend on into the cache entry of the offset, replacing the sums memoized for it
+void ImageTextureFeatures::calculateCooccurrenceMatrix() {
+    if (!isSupportedSection()) {
+        return;
+    }
+    CooccurrenceOffset offset{ angle, distance };
+    TextureCacheEntry& entry = cacheEntry(offset.rowShift(), offset.colShift());
+    buildCooccurrenceMatrix(entry.dx, entry.dy);
+
+    // Single traversal of the non-zero cells; probabilities are the counts divided by sums.pairs
+    LUMBER_SCOPED_TIMER(Metric::TextureSums);
+    entry.sums = CooccurrenceSums();
+    entry.sums.addCells(cooccurrenceMatrix.ptr<int>(), nonzeroCells, cooccurrenceMatrix.rows, kAllSums);
+    entry.sumGroups = kAllSums;
+    entry.validFeatures = 0;  // Derived again from the new sums on next use
+}
 
-    int total_pairs = 0;  // Total number of valid pixel pairs
+namespace {
+    // Co-occurrence histograms of calculateMultiOffsetFeatures(), one levels x levels block per offset.
+    // Kept zeroed between calls by clearing only the non-zero cells, so a call touches the cells its
+    // pairs fill rather than the whole buffer.
+    thread_local std::vector<int32_t> multiOffsetFreq;
+    // Non-zero cells of each histogram, one levels x levels + 1 block per offset (one spare for the
+    // unconditional stores of addPair() and listNonzeroCells())
+    thread_local std::vector<int> multiOffsetCells;
+    thread_local std::vector<int> multiOffsetCellList;  // Cells of one offset, in the form addCells() takes
+
+    // Counts one pair. When Tracked, a cell's first pair appends it to the non-zero cells: the cell is
+    // always written past the end of the list and kept only by advancing the count, so there is no branch.
+    template <bool Tracked>
+    inline void addPair(int32_t* freq, int* cells, int& cellCount, int cell) {
+        const int32_t count = freq[cell]++;
+        if (Tracked) {
+            cells[cellCount] = cell;
+            cellCount += count == 0;
+        }
+    }
 
-    // Loop through the image to fill the co-occurrence frequency matrix
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            uchar pixel_value = imageSection.at<uchar>(i, j);  // Get the pixel value at (i, j)
-            int neighbor_x = i + dx;  // Calculate the neighbor's x position
-            int neighbor_y = j + dy;  // Calculate the neighbor's y position
-
-            // Ensure the neighbor is within bounds
-            if (neighbor_x >= 0 && neighbor_x < rows && neighbor_y >= 0 && neighbor_y < cols) {
-                uchar neighbor_value = imageSection.at<uchar>(neighbor_x, neighbor_y);
-                cooccurrence_freq.at<int>(pixel_value, neighbor_value) += 1;  // Increment the co-occurrence frequency
-                total_pairs += 1;  // Increment total valid pairs
+    // Adds the pairs of one row segment: reference pixels a[0..n) and their neighbors b[0..n)
+    template <bool Symmetric, bool Tracked>
+    inline void accumulateSegment(const uchar* a, const uchar* b, int n, int levels, int32_t* freq, int* cells, int& cellCount) {
+        for (int j = 0; j < n; ++j) {
+            addPair<Tracked>(freq, cells, cellCount, a[j] * levels + b[j]);
+            if (Symmetric) {
+                addPair<Tracked>(freq, cells, cellCount, b[j] * levels + a[j]);  // Count the pair in both directions
             }
         }
     }
 
-    // Convert frequency matrix to a probability matrix
-    if (total_pairs > 0) {
-        cooccurrence_freq = cooccurrence_freq / total_pairs;
+    // Lists the non-zero cells of a histogram the pairs filled without tracking, in one branch-free pass
+    int listNonzeroCells(const int32_t* freq, size_t size, int* cells) {
+        int count = 0;
+        for (size_t cell = 0; cell < size; ++cell) {
+            cells[count] = static_cast<int>(cell);
+            count += freq[cell] != 0;
+        }
+        return count;
     }
-
-    // Store the resulting co-occurrence matrix
-    cooccurrenceMatrix = cooccurrence_freq;
 }
 
-// Calculates the first and second moments (Mx1 and Mx2) of the co-occurrence matrix
-void ImageTextureFeatures::calculateMoments() {
-    int num_levels = cooccurrenceMatrix.rows;
-    cv::Mat indices = cv::Mat(num_levels, 1, CV_32S);
-    for (int i = 0; i < num_levels; ++i) {
-        indices.at<int>(i, 0) = i;  // Fill indices with pixel levels [0, num_levels)
+// Builds the co-occurrence histograms of every offset in one traversal of the image section and returns
+// the texture features of each offset, in input order. Each row is read once as the reference row and
+// the neighbor rows of all offsets are looked up while it is in cache. The in-bounds column range of
+// each offset is clipped once, so the inner loop has no bounds checks. An offset with fewer pairs than
+// histogram cells lists its non-zero cells as their first pair is counted; any other lists them with one
+// pass over its histogram afterwards, which then costs less than tracking every pair.
+std::vector<HaralickFeatures> ImageTextureFeatures::calculateMultiOffsetFeatures(
+    const std::vector<CooccurrenceOffset>& offsets, bool symmetric) const {
+    std::vector<HaralickFeatures> features;
+    if (!isSupportedSection()) {
+        features.resize(offsets.size());
+        return features;
+    }
+    prepareQuantizedSection();
+    const int rows = quantizedSection.rows;
+    const int cols = quantizedSection.cols;
+    const int num_levels = quantizer.getLevels();
+    const size_t matrix_size = static_cast<size_t>(num_levels) * num_levels;
+    const int num_offsets = static_cast<int>(offsets.size());
+
+    // In-bounds reference pixels of each offset: rows [row_begin, row_end), columns [col_begin, col_end)
+    std::vector<int> dx(num_offsets), dy(num_offsets), row_begin(num_offsets), row_end(num_offsets);
+    std::vector<int> col_begin(num_offsets), width(num_offsets);
+    std::vector<char> tracked(num_offsets);
+    for (int k = 0; k < num_offsets; ++k) {
+        dx[k] = offsets[k].rowShift();
+        dy[k] = offsets[k].colShift();
+        row_begin[k] = std::max(0, -dx[k]);
+        row_end[k] = std::min(rows, rows - dx[k]);
+        col_begin[k] = std::max(0, -dy[k]);
+        width[k] = std::max(0, std::min(cols, cols - dy[k]) - col_begin[k]);
+        const int64_t pairs = static_cast<int64_t>(std::max(0, row_end[k] - row_begin[k])) * width[k] * (symmetric ? 2 : 1);
+        tracked[k] = pairs < static_cast<int64_t>(matrix_size);
     }
 
-    double Mx1 = 0;
-    double Mx2 = 0;
-
-    // Calculate Mx1 (mean of pixel values)
-    for (int i = 0; i < num_levels; ++i) {
-        for (int j = 0; j < num_levels; ++j) {
-            Mx1 += indices.at<int>(i, 0) * cooccurrenceMatrix.at<int>(i, j);
+    if (multiOffsetFreq.size() < num_offsets * matrix_size) {
+        multiOffsetFreq.assign(num_offsets * matrix_size, 0);
+    }
+    if (multiOffsetCells.size() < num_offsets * (matrix_size + 1)) {
+        multiOffsetCells.resize(num_offsets * (matrix_size + 1));
+    }
+    std::vector<int> cell_count(num_offsets, 0);
+    for (int i = 0; i < rows; ++i) {
+        const uchar* reference = quantizedSection.ptr<uchar>(i);
+        for (int k = 0; k < num_offsets; ++k) {
+            if (i < row_begin[k] || i >= row_end[k] || width[k] == 0) {
+                continue;
+            }
+            const uchar* a = reference + col_begin[k];
+            const uchar* b = quantizedSection.ptr<uchar>(i + dx[k]) + col_begin[k] + dy[k];
+            int32_t* freq = multiOffsetFreq.data() + k * matrix_size;
+            int* cells = multiOffsetCells.data() + k * (matrix_size + 1);
+            if (symmetric) {
+                if (tracked[k]) {
+                    accumulateSegment<true, true>(a, b, width[k], num_levels, freq, cells, cell_count[k]);
+                }
+                else {
+                    accumulateSegment<true, false>(a, b, width[k], num_levels, freq, cells, cell_count[k]);
+                }
+            }
+            else {
+                if (tracked[k]) {
+                    accumulateSegment<false, true>(a, b, width[k], num_levels, freq, cells, cell_count[k]);
+                }
+                else {
+                    accumulateSegment<false, false>(a, b, width[k], num_levels, freq, cells, cell_count[k]);
+                }
+            }
         }
     }
 
-    // Calculate Mx2 (mean of target pixel values)
-    for (int i = 0; i < num_levels; ++i) {
-        for (int j = 0; j < num_levels; ++j) {
-            Mx2 += indices.at<int>(j, 0) * cooccurrenceMatrix.at<int>(i, j);
+    features.reserve(num_offsets);
+    for (int k = 0; k < num_offsets; ++k) {
+        int32_t* freq = multiOffsetFreq.data() + k * matrix_size;
+        int* cells = multiOffsetCells.data() + k * (matrix_size + 1);
+        if (!tracked[k]) {
+            cell_count[k] = listNonzeroCells(freq, matrix_size, cells);
+        }
+        multiOffsetCellList.assign(cells, cells + cell_count[k]);
+        CooccurrenceSums sums;
+        sums.addCells(freq, multiOffsetCellList, num_levels, kAllSums);
+        features.push_back(sums.toFeatures());
+        for (int cell : multiOffsetCellList) {
+            freq[cell] = 0;
         }
     }
+    return features;
+}
 
-    moments = std::make_tuple(Mx1, Mx2);  // Store the moments in a tuple
+// Averages the symmetric texture features of the 0, 45, 90 and 135 degree offsets at the given distance
+HaralickFeatures ImageTextureFeatures::calculateRotationAveragedFeatures(double Distance) const {
+    std::vector<CooccurrenceOffset> offsets;
+    for (double Angle : { 0.0, 45.0, 90.0, 135.0 }) {
+        offsets.push_back(CooccurrenceOffset{ Angle, Distance });
+    }
+    std::vector<HaralickFeatures> per_angle = calculateMultiOffsetFeatures(offsets, true);
+
+    HaralickFeatures average;
+    for (const HaralickFeatures& f : per_angle) {
+        average.mx1 += f.mx1 / per_angle.size();
+        average.mx2 += f.mx2 / per_angle.size();
+        average.clusterShade += f.clusterShade / per_angle.size();
+        average.clusterProminence += f.clusterProminence / per_angle.size();
+        average.localHomogeneity += f.localHomogeneity / per_angle.size();
+        average.energy += f.energy / per_angle.size();
+        average.entropy += f.entropy / per_angle.size();
+        average.inertia += f.inertia / per_angle.size();
+    }
+    return average;
+}
+
+// Extracts the feature vectors of many patches in parallel. Every patch writes only its own slot,
+// so the result does not depend on scheduling.
+std::vector<FeatureVector> ImageTextureFeatures::extractBatch(const std::vector<cv::Mat>& patches,
+    const ExtractionSettings& settings, WorkStealingPool& pool) {
+    std::vector<FeatureVector> features(patches.size());
+    pool.parallelFor(patches.size(), [&](size_t i) {
+        // One context per thread, kept between batches, so steady-state extraction does not allocate
+        thread_local ExtractionContext context;
+        context.configure(settings);
+        features[i] = context.extract(patches[i]);
+    });
+    return features;
+}
+
+// Extracts the features of every channel separately, each with the settings' quantization
+std::vector<FeatureVector> ImageTextureFeatures::extractChannelFeatures(const cv::Mat& image, const ExtractionSettings& settings) {
+    std::vector<FeatureVector> features;
+    ExtractionSettings channel_settings = settings;
+    channel_settings.color = ColorTransform::Channel;
+    for (int c = 0; c < image.channels(); ++c) {
+        channel_settings.channel = c;
+        features.push_back(ImageTextureFeatures(image, "", channel_settings).getFeatureVector());
+    }
+    return features;
 }
 
 // Calculates the cluster shade of the co-occurrence matrix
 void ImageTextureFeatures::calculateClusterShade() {
-    double Mx1 = std::get<0>(moments);
-    double Mx2 = std::get<1>(moments);
-    int num_levels = cooccurrenceMatrix.rows;
-    clusterShade = 0.0;
-
-    // Calculate the cluster shade using the formula
-    for (int i = 0; i < num_levels; ++i) {
-        for (int j = 0; j < num_levels; ++j) {
-            double diff = i + j - Mx1 - Mx2;
-            clusterShade += std::pow(diff, 3) * cooccurrenceMatrix.at<int>(i, j);
-        }
-    }
+    textureFeature(Feature::ClusterShade);
 }
 
 // Calculates the cluster prominence of the co-occurrence matrix
 void ImageTextureFeatures::calculateClusterProminence() {
-    double Mx1 = std::get<0>(moments);
-    double Mx2 = std::get<1>(moments);
-    int num_levels = cooccurrenceMatrix.rows;
-    clusterProminence = 0.0;
-
-    // Calculate the cluster prominence using the formula
-    for (int i = 0; i < num_levels; ++i) {
-        for (int j = 0; j < num_levels; ++j) {
-            double diff = i + j - Mx1 - Mx2;
-            clusterProminence += std::pow(diff, 4) * cooccurrenceMatrix.at<int>(i, j);
-        }
-    }
+    textureFeature(Feature::ClusterProminence);
 }
 
 // Calculates the local homogeneity of the co-occurrence matrix
 void ImageTextureFeatures::calculateLocalHomogeneity() {
-    int num_levels = cooccurrenceMatrix.rows;
-    localHomogeneity = 0.0;
-
-    // Calculate the local homogeneity using the formula
-    for (int i = 0; i < num_levels; ++i) {
-        for (int j = 0; j < num_levels; ++j) {
-            double homogeneity_term = 1.0 / (1 + std::pow(i - j, 2));  // Homogeneity term formula
-            localHomogeneity += homogeneity_term * cooccurrenceMatrix.at<int>(i, j);
-        }
-    }
+    textureFeature(Feature::LocalHomogeneity);
 }
 
 // Calculates the energy of the co-occurrence matrix
 void ImageTextureFeatures::calculateEnergy() {
-    energy = 0.0;
-    int num_levels = cooccurrenceMatrix.rows;
-
-    // Calculate the energy using the formula
-    for (int i = 0; i < num_levels; ++i) {
-        for (int j = 0; j < num_levels; ++j) {
-            energy += std::pow(cooccurrenceMatrix.at<int>(i, j), 2);
-        }
-    }
+    textureFeature(Feature::Energy);
 }
 
 // Calculates the entropy of the co-occurrence matrix
 void ImageTextureFeatures::calculateEntropy() {
-    entropy = 0.0;
-    int num_levels = cooccurrenceMatrix.rows;
-
-    // Calculate the entropy using the formula
-    for (int i = 0; i < num_levels; ++i) {
-        for (int j = 0; j < num_levels; ++j) {
-            double p = cooccurrenceMatrix.at<int>(i, j);  // Probability value
-            if (p > 0) {
-                entropy -= p * std::log2(p);  // Entropy formula
-            }
-        }
-    }
+    textureFeature(Feature::Entropy);
 }
 
 // Calculates the inertia of the co-occurrence matrix
 void ImageTextureFeatures::calculateInertia() {
-    inertia = 0.0;
-    int num_levels = cooccurrenceMatrix.rows;
+    textureFeature(Feature::Inertia);
+}
 
-    // Calculate the inertia using the formula
-    for (int i = 0; i < num_levels; ++i) {
-        for (int j = 0; j < num_levels; ++j) {
-            inertia += std::pow(i - j, 2) * cooccurrenceMatrix.at<int>(i, j);
-        }
+// Calculates all six texture features, gathering the sums they need in one pass over the matrix
+void ImageTextureFeatures::calculateHaralickFeatures() {
+    if (!isSupportedSection()) {
+        return;
+    }
+    gatherSums(kAllSums);
+    for (Feature feature : { Feature::Inertia, Feature::ClusterShade, Feature::ClusterProminence,
+        Feature::LocalHomogeneity, Feature::Energy, Feature::Entropy }) {
+        textureFeature(feature);
     }
 }
 
-// Calculates all the texture features by calling respective functions
+// Calculates all the texture features
 void ImageTextureFeatures::calculateTextureFeatures() {
     calculateCooccurrenceMatrix();
-    calculateMoments();
-    calculateClusterShade();
-    calculateClusterProminence();
-    calculateLocalHomogeneity();
-    calculateEnergy();
-    calculateEntropy();
-    calculateInertia();
+    calculateHaralickFeatures();
 }
@@ -0,0 +1,195 @@
+#include "InspectionPipeline.h"
+#include "ExtractionContext.h"
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include <thread>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Adds the time since start to a stage's busy time
+    void addBusyTime(StageCounters& stage, Clock::time_point start) {
+        stage.busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+}
+
+// Constructor: Stores the classifier and settings
+InspectionPipeline::InspectionPipeline(const BayesianDefectClassifier& Classifier, const PipelineSettings& Settings)
+    : classifier{ Classifier },
+    settings{ Settings } {
+    if (settings.extractionWorkers == 0) {
+        settings.extractionWorkers = 1;
+    }
+}
+
+// Registers the counters of a stage
+StageCounters& InspectionPipeline::addStage(const std::string& name) {
+    counters.push_back(std::make_unique<StageCounters>());
+    counters.back()->name = name;
+    return *counters.back();
+}
+
+// Starts one thread per stage, drains the results on the calling thread and joins the stages
+void InspectionPipeline::run(const std::function<bool(BoardFrame&)>& source, const std::function<void(const TileResult&)>& sink) {
+    counters.clear();
+    StageCounters& decode_stage = addStage("decode");
+    StageCounters& tile_stage = addStage("tile");
+    StageCounters& extract_stage = addStage("extract");
+    StageCounters& filter_stage = addStage("clear-filter");
+    StageCounters& classify_stage = addStage("classify");
+
+    const unsigned workers = settings.extractionWorkers;
+    BoundedQueue<BoardFrame> frames(settings.queueCapacity);
+    std::vector<std::unique_ptr<BoundedQueue<TileResult>>> to_extract, extracted;
+    for (unsigned w = 0; w < workers; ++w) {
+        to_extract.push_back(std::make_unique<BoundedQueue<TileResult>>(settings.queueCapacity));
+        extracted.push_back(std::make_unique<BoundedQueue<TileResult>>(settings.queueCapacity));
+    }
+    BoundedQueue<TileResult> to_classify(settings.queueCapacity);
+    BoundedQueue<TileResult> results(settings.queueCapacity);
+
+    const Clock::time_point run_start = Clock::now();
+    std::vector<std::thread> stages;
+
+    // Decode: pull frames from the source
+    stages.emplace_back([&] {
+        size_t index = 0;
+        while (true) {
+            Clock::time_point start = Clock::now();
+            BoardFrame frame;
+            bool more = source(frame);
+            addBusyTime(decode_stage, start);
+            if (!more) {
+                break;
+            }
+            frame.index = index++;
+            decode_stage.items += 1;
+            frames.push(std::move(frame));
+        }
+        frames.close();
+    });
+
+    // Tile: cut every frame into tiles and deal them round-robin to the extraction workers
+    stages.emplace_back([&] {
+        BoardFrame frame;
+        size_t next_worker = 0;
+        while (frames.pop(frame)) {
+            Clock::time_point start = Clock::now();
+            const int size = settings.tileSize;
+            for (int y = 0; y + size <= frame.image.rows; y += settings.tileStride) {
+                for (int x = 0; x + size <= frame.image.cols; x += settings.tileStride) {
+                    TileResult tile;
+                    tile.frame = frame.index;
+                    tile.source = frame.source;
+                    tile.rect = cv::Rect(x, y, size, size);
+                    tile.tile = frame.image(tile.rect);
+                    tile_stage.items += 1;
+                    addBusyTime(tile_stage, start);
+                    to_extract[next_worker]->push(std::move(tile));
+                    next_worker = (next_worker + 1) % workers;
+                    start = Clock::now();
+                }
+            }
+            addBusyTime(tile_stage, start);
+        }
+        // A terminator in the next worker's queue tells the filter stage where the stream ends
+        TileResult end;
+        end.last = true;
+        to_extract[next_worker]->push(std::move(end));
+        for (auto& queue : to_extract) {
+            queue->close();
+        }
+    });
+
+    // Extract: texture features of every tile
+    for (unsigned w = 0; w < workers; ++w) {
+        stages.emplace_back([&, w] {
+            TileResult tile;
+            ExtractionContext context(settings.extraction);  // Buffers reused for every tile of this worker
+            while (to_extract[w]->pop(tile)) {
+                if (!tile.last) {
+                    Clock::time_point start = Clock::now();
+                    context.setPatch(tile.tile);
+                    StatisticalFeatures stats = context.getStatisticalFeatures();
+                    if (settings.cascade && classifier.passesClearCascade(stats)) {
+                        // Clear wood by its statistical features alone; the texture features are never computed
+                        tile.features.values.fill(std::numeric_limits<double>::quiet_NaN());
+                        setStatisticalFeatures(tile.features, stats);
+                        tile.clear = true;
+                        tile.label = "Clear area";
+                    }
+                    else {
+                        tile.features = context.getFeatureVector();
+                    }
+                    tile.tile.release();
+                    extract_stage.items += 1;
+                    addBusyTime(extract_stage, start);
+                }
+                extracted[w]->push(std::move(tile));
+            }
+            extracted[w]->close();
+        });
+    }
+
+    // Clear-area pre-filter: collect the workers' output in dealing order and mark clear tiles
+    stages.emplace_back([&] {
+        TileResult tile;
+        size_t next_worker = 0;
+        while (extracted[next_worker]->pop(tile) && !tile.last) {
+            Clock::time_point start = Clock::now();
+            if (!tile.clear && settings.clearThreshold >= 0.0 && classifier.isClearArea(tile.features, settings.clearThreshold)) {
+                tile.clear = true;
+                tile.label = "Clear area";
+            }
+            filter_stage.items += 1;
+            addBusyTime(filter_stage, start);
+            to_classify.push(std::move(tile));
+            next_worker = (next_worker + 1) % workers;
+        }
+        to_classify.close();
+    });
+
+    // Classify: pairwise Bayesian voting for every tile that is not clear wood
+    stages.emplace_back([&] {
+        TileResult tile;
+        while (to_classify.pop(tile)) {
+            if (!tile.clear) {
+                Clock::time_point start = Clock::now();
+                int index = classifier.predictClassIndex(tile.features);
+                tile.label = index >= 0 ? classifier.classModels[index].name : std::string();
+                classify_stage.items += 1;
+                addBusyTime(classify_stage, start);
+            }
+            results.push(std::move(tile));
+        }
+        results.close();
+    });
+
+    TileResult result;
+    while (results.pop(result)) {
+        sink(result);
+    }
+    for (auto& stage : stages) {
+        stage.join();
+    }
+    wallSeconds = std::chrono::duration<double>(Clock::now() - run_start).count();
+}
+
+// Writes a throughput table of the last run
+void InspectionPipeline::reportThroughput(std::ostream& out) const {
+    out << "stage            items     items/s   utilization" << std::endl;
+    for (const auto& stage : counters) {
+        double busy = stage->busyNanoseconds.load() * 1e-9;
+        double rate = wallSeconds > 0.0 ? stage->items.load() / wallSeconds : 0.0;
+        double utilization = wallSeconds > 0.0 ? busy / wallSeconds : 0.0;
+        if (stage->name == "extract") {
+            utilization /= settings.extractionWorkers;  // Busy time is summed over the workers
+        }
+        out << std::left << std::setw(14) << stage->name << std::right
+            << std::setw(9) << stage->items.load()
+            << std::setw(12) << std::fixed << std::setprecision(1) << rate
+            << std::setw(13) << std::setprecision(1) << 100.0 * utilization << "%" << std::endl;
+    }
+    out << "wall time " << std::setprecision(3) << wallSeconds << " s" << std::endl;
+}
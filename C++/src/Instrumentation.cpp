@@ -0,0 +1,176 @@
+#include "Instrumentation.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <utility>
+
+namespace {
+    // Log-linear histogram: values below 4 have their own bucket, larger values fall into one of four
+    // buckets per power of two, so a bucket spans at most 25% of its lower bound
+    const int kBuckets = 256;
+
+    struct MetricHistogram {
+        std::atomic<uint64_t> sum{ 0 };
+        std::atomic<uint64_t> min{ std::numeric_limits<uint64_t>::max() };
+        std::atomic<uint64_t> max{ 0 };
+        std::atomic<uint64_t> buckets[kBuckets] = {};
+    };
+
+    MetricHistogram histograms[kMetricCount];
+
+    const char* const kMetricNames[kMetricCount] = {
+        "statistical_features", "quantization", "cooccurrence_matrix", "texture_sums",
+        "classification", "patch_pixels", "nonzero_cells", "vote_margin"
+    };
+
+    bool isTimer(int metric) {
+        return metric <= static_cast<int>(Metric::Classification);
+    }
+
+    int bucketIndex(uint64_t value) {
+        if (value < 4) {
+            return static_cast<int>(value);
+        }
+        int exponent = 63;
+        while ((value >> exponent) == 0) {
+            --exponent;
+        }
+        int sub = static_cast<int>((value >> (exponent - 2)) & 3);
+        return 4 * (exponent - 1) + sub;
+    }
+
+    // Midpoint of a bucket, used as the value of every sample in it
+    double bucketValue(int index) {
+        if (index < 4) {
+            return index;
+        }
+        int exponent = index / 4 + 1;
+        double width = std::ldexp(1.0, exponent - 2);
+        return (4 + index % 4) * width + 0.5 * width;
+    }
+}
+
+// Adds one value to a metric
+void recordMetric(Metric metric, uint64_t value) {
+    MetricHistogram& histogram = histograms[static_cast<int>(metric)];
+    histogram.sum.fetch_add(value, std::memory_order_relaxed);
+    histogram.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t current = histogram.min.load(std::memory_order_relaxed);
+    while (value < current && !histogram.min.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+    current = histogram.max.load(std::memory_order_relaxed);
+    while (value > current && !histogram.max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+// Summarizes every histogram. Recording continues meanwhile, so a snapshot taken under load may be off by
+// the few values recorded while it is read.
+std::vector<MetricSnapshot> snapshotMetrics() {
+    std::vector<MetricSnapshot> snapshot(kMetricCount);
+    for (int m = 0; m < kMetricCount; ++m) {
+        const MetricHistogram& histogram = histograms[m];
+        MetricSnapshot& s = snapshot[m];
+        s.name = kMetricNames[m];
+        s.unit = isTimer(m) ? "ns" : "count";
+
+        uint64_t counts[kBuckets];
+        uint64_t total = 0;
+        for (int b = 0; b < kBuckets; ++b) {
+            counts[b] = histogram.buckets[b].load(std::memory_order_relaxed);
+            total += counts[b];
+        }
+        if (total == 0) {
+            continue;
+        }
+        s.count = total;
+        s.sum = histogram.sum.load(std::memory_order_relaxed);
+        s.min = histogram.min.load(std::memory_order_relaxed);
+        s.max = histogram.max.load(std::memory_order_relaxed);
+        s.mean = static_cast<double>(s.sum) / total;
+
+        double* percentiles[3] = { &s.p50, &s.p90, &s.p99 };
+        const double fractions[3] = { 0.50, 0.90, 0.99 };
+        for (int p = 0; p < 3; ++p) {
+            uint64_t rank = static_cast<uint64_t>(std::ceil(fractions[p] * total));
+            uint64_t seen = 0;
+            int b = 0;
+            while (b < kBuckets - 1 && seen + counts[b] < rank) {
+                seen += counts[b++];
+            }
+            *percentiles[p] = std::min(std::max(bucketValue(b), static_cast<double>(s.min)), static_cast<double>(s.max));
+        }
+    }
+    return snapshot;
+}
+
+// Clears every metric
+void resetMetrics() {
+    for (MetricHistogram& histogram : histograms) {
+        histogram.sum.store(0, std::memory_order_relaxed);
+        histogram.min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+        histogram.max.store(0, std::memory_order_relaxed);
+        for (auto& bucket : histogram.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+// Writes one line per metric that recorded any value
+void writeMetricsText(std::ostream& out, const std::vector<MetricSnapshot>& snapshot) {
+    if (!kInstrumentationEnabled) {
+        out << "Instrumentation is disabled in this build (ENABLE_INSTRUMENTATION=OFF)." << std::endl;
+        return;
+    }
+    out << std::left << std::setw(22) << "metric" << std::right << std::setw(7) << "unit" << std::setw(12) << "count"
+        << std::setw(12) << "mean" << std::setw(12) << "p50" << std::setw(12) << "p90" << std::setw(12) << "p99"
+        << std::setw(12) << "max" << '\n';
+    for (const MetricSnapshot& s : snapshot) {
+        if (s.count == 0) {
+            continue;
+        }
+        out << std::left << std::setw(22) << s.name << std::right << std::setw(7) << s.unit << std::setw(12) << s.count
+            << std::fixed << std::setprecision(0) << std::setw(12) << s.mean << std::setw(12) << s.p50
+            << std::setw(12) << s.p90 << std::setw(12) << s.p99 << std::setw(12) << s.max << '\n';
+    }
+    out << std::defaultfloat << std::flush;
+}
+
+// Writes the snapshot as {"enabled": ..., "metrics": {"<name>": {...}, ...}} on one line
+void writeMetricsJson(std::ostream& out, const std::vector<MetricSnapshot>& snapshot) {
+    out << "{\"enabled\":" << (kInstrumentationEnabled ? "true" : "false") << ",\"metrics\":{";
+    for (size_t m = 0; m < snapshot.size(); ++m) {
+        const MetricSnapshot& s = snapshot[m];
+        out << (m ? "," : "") << '"' << s.name << "\":{\"unit\":\"" << s.unit << "\",\"count\":" << s.count
+            << ",\"sum\":" << s.sum << ",\"min\":" << s.min << ",\"max\":" << s.max
+            << ",\"mean\":" << s.mean << ",\"p50\":" << s.p50 << ",\"p90\":" << s.p90 << ",\"p99\":" << s.p99 << '}';
+    }
+    out << "}}" << std::endl;
+}
+
+// Starts the reporting thread
+MetricsReporter::MetricsReporter(std::chrono::milliseconds Interval, std::function<void(const std::vector<MetricSnapshot>&)> Report)
+    : interval{ Interval },
+    report{ std::move(Report) } {
+    thread = std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+            lock.unlock();
+            report(snapshotMetrics());
+            lock.lock();
+        }
+    });
+}
+
+// Stops the reporting thread and reports the final state
+MetricsReporter::~MetricsReporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+    report(snapshotMetrics());
+}
@@ -0,0 +1,169 @@
+#include "IntegralStatistics.h"
+#include <iostream>
+#include <algorithm>
+
+// Constructor: Builds the summed-area tables in one pass; entry (r, c) holds the sums over [0, r) x [0, c)
+IntegralStatistics::IntegralStatistics(const cv::Mat& Image)
+    : image{ Image },
+    rows{ Image.rows },
+    cols{ Image.cols } {
+
+    if (image.empty() || image.type() != CV_8UC1) {
+        std::cerr << "The input image is not an 8-bit grayscale image." << std::endl;
+        rows = 0;
+        cols = 0;
+    }
+
+    powerTable.assign(4 * static_cast<size_t>(rows + 1) * (cols + 1), 0);
+    for (int i = 0; i < rows; ++i) {
+        const uchar* pixels = image.ptr<uchar>(i);
+        int64_t row_sum[4] = { 0, 0, 0, 0 };
+        const int64_t* above = powerSums(i, 0);
+        int64_t* current = powerTable.data() + 4 * (static_cast<size_t>(i + 1) * (cols + 1));
+        for (int j = 0; j < cols; ++j) {
+            const int64_t x = pixels[j];
+            const int64_t x2 = x * x;
+            row_sum[0] += x;
+            row_sum[1] += x2;
+            row_sum[2] += x2 * x;
+            row_sum[3] += x2 * x2;
+            for (int k = 0; k < 4; ++k) {
+                current[4 * (j + 1) + k] = above[4 * (j + 1) + k] + row_sum[k];
+            }
+        }
+    }
+}
+
+// Statistical features of a rectangle from the four corners of each summed-area table
+StatisticalFeatures IntegralStatistics::regionStatistics(const cv::Rect& roi) const {
+    cv::Rect box = roi & cv::Rect(0, 0, cols, rows);
+    if (box.empty()) {
+        return StatisticalFeatures();
+    }
+
+    const int64_t* a = powerSums(box.y, box.x);
+    const int64_t* b = powerSums(box.y, box.x + box.width);
+    const int64_t* c = powerSums(box.y + box.height, box.x);
+    const int64_t* d = powerSums(box.y + box.height, box.x + box.width);
+
+    IntensitySums sums;
+    sums.count = static_cast<int64_t>(box.width) * box.height;
+    for (int k = 0; k < 4; ++k) {
+        sums.sum[k] = d[k] - b[k] - c[k] + a[k];
+    }
+    return sums.toFeatures();
+}
+
+// Pair counts of the reference pixels in [0, gridRow * cellSize) x [0, gridCol * cellSize)
+const int32_t* IntegralStatistics::pairCounts(int gridRow, int gridCol) const {
+    return pairTable.data() + (static_cast<size_t>(gridRow) * gridCols + gridCol) * levels * levels;
+}
+
+// Adds the pairs of the reference pixels in [row_begin, row_end) x [col_begin, col_end) to counts
+void IntegralStatistics::accumulatePairs(int row_begin, int row_end, int col_begin, int col_end, int64_t* counts) const {
+    for (int i = row_begin; i < row_end; ++i) {
+        const uchar* a = levelImage.ptr<uchar>(i);
+        const uchar* b = levelImage.ptr<uchar>(i + dx) + dy;
+        for (int j = col_begin; j < col_end; ++j) {
+            ++counts[a[j] * levels + b[j]];
+        }
+    }
+}
+
+// Builds per-cell pair histograms on the grid and turns them into a 2-D prefix sum.
+// A pair is stored at its reference pixel and only when its neighbor lies inside the image.
+void IntegralStatistics::buildCooccurrenceTable(int Levels, double Angle, double Distance, int CellSize) {
+    GrayLevelQuantizer quantizer(Levels, QuantizationMode::Uniform);
+    levels = quantizer.getLevels();
+    cellSize = std::max(1, CellSize);
+    CooccurrenceOffset offset{ Angle, Distance };
+    dx = offset.rowShift();
+    dy = offset.colShift();
+    quantizer.apply(image, levelImage);
+
+    gridRows = rows / cellSize + 1;
+    gridCols = cols / cellSize + 1;
+    const size_t bins = static_cast<size_t>(levels) * levels;
+    pairTable.assign(static_cast<size_t>(gridRows) * gridCols * bins, 0);
+
+    // Valid reference pixels: their neighbor (i + dx, j + dy) is inside the image
+    const int row_begin = std::max(0, -dx);
+    const int row_end = std::min(rows, rows - dx);
+    const int col_begin = std::max(0, -dy);
+    const int col_end = std::min(cols, cols - dy);
+
+    std::vector<int64_t> cell_counts(bins);
+    for (int gr = 1; gr < gridRows; ++gr) {
+        for (int gc = 1; gc < gridCols; ++gc) {
+            std::fill(cell_counts.begin(), cell_counts.end(), 0);
+            accumulatePairs(std::max(row_begin, (gr - 1) * cellSize), std::min(row_end, gr * cellSize),
+                std::max(col_begin, (gc - 1) * cellSize), std::min(col_end, gc * cellSize), cell_counts.data());
+
+            int32_t* out = pairTable.data() + (static_cast<size_t>(gr) * gridCols + gc) * bins;
+            const int32_t* up = pairCounts(gr - 1, gc);
+            const int32_t* left = pairCounts(gr, gc - 1);
+            const int32_t* diagonal = pairCounts(gr - 1, gc - 1);
+            for (size_t k = 0; k < bins; ++k) {
+                out[k] = static_cast<int32_t>(cell_counts[k]) + up[k] + left[k] - diagonal[k];
+            }
+        }
+    }
+}
+
+// Texture features of a rectangle. The pairs inside the rectangle are exactly those whose reference pixel
+// lies in the rectangle shrunk by the offset; the grid-aligned core of that region comes from the table,
+// the strips around it are counted directly.
+HaralickFeatures IntegralStatistics::regionTexture(const cv::Rect& roi) const {
+    if (!hasCooccurrenceTable()) {
+        return HaralickFeatures();
+    }
+    cv::Rect box = roi & cv::Rect(0, 0, cols, rows);
+    const int r0 = box.y + std::max(0, -dx);
+    const int r1 = box.y + box.height - std::max(0, dx);
+    const int c0 = box.x + std::max(0, -dy);
+    const int c1 = box.x + box.width - std::max(0, dy);
+    if (box.empty() || r0 >= r1 || c0 >= c1) {
+        return HaralickFeatures();
+    }
+
+    const size_t bins = static_cast<size_t>(levels) * levels;
+    thread_local std::vector<int64_t> counts;
+    counts.assign(bins, 0);
+
+    // Grid lines enclosed by the shrunk rectangle
+    const int gr0 = (r0 + cellSize - 1) / cellSize;
+    const int gr1 = r1 / cellSize;
+    const int gc0 = (c0 + cellSize - 1) / cellSize;
+    const int gc1 = c1 / cellSize;
+
+    if (gr0 < gr1 && gc0 < gc1) {
+        const int32_t* a = pairCounts(gr0, gc0);
+        const int32_t* b = pairCounts(gr0, gc1);
+        const int32_t* c = pairCounts(gr1, gc0);
+        const int32_t* d = pairCounts(gr1, gc1);
+        for (size_t k = 0; k < bins; ++k) {
+            counts[k] += static_cast<int64_t>(d[k]) - b[k] - c[k] + a[k];
+        }
+
+        accumulatePairs(r0, gr0 * cellSize, c0, c1, counts.data());                              // Top strip
+        accumulatePairs(gr1 * cellSize, r1, c0, c1, counts.data());                              // Bottom strip
+        accumulatePairs(gr0 * cellSize, gr1 * cellSize, c0, gc0 * cellSize, counts.data());      // Left strip
+        accumulatePairs(gr0 * cellSize, gr1 * cellSize, gc1 * cellSize, c1, counts.data());      // Right strip
+    }
+    else {
+        accumulatePairs(r0, r1, c0, c1, counts.data());  // Too small to contain a grid cell
+    }
+
+    CooccurrenceSums sums;
+    for (size_t k = 0; k < bins; ++k) {
+        if (counts[k] != 0) {
+            sums.addCell(static_cast<int>(k / levels), static_cast<int>(k % levels), counts[k]);
+        }
+    }
+    return sums.toFeatures();
+}
+
+// All features of a rectangle in FeatureVector order
+FeatureVector IntegralStatistics::regionFeatures(const cv::Rect& roi) const {
+    return makeFeatureVector(regionStatistics(roi), regionTexture(roi));
+}
@@ -0,0 +1,119 @@
+#include "IntensityStatistics.h"
+#include <cmath>
+
+// Converts the power sums into central moments via their binomial expansion about the mean
+StatisticalFeatures IntensitySums::toFeatures() const {
+    StatisticalFeatures features;
+    if (count <= 0) {
+        return features;
+    }
+
+    const double n = static_cast<double>(count);
+    const double m1 = sum[0] / n;
+    const double e2 = sum[1] / n;
+    const double e3 = sum[2] / n;
+    const double e4 = sum[3] / n;
+
+    const double central2 = e2 - m1 * m1;
+    const double central3 = e3 - 3.0 * m1 * e2 + 2.0 * m1 * m1 * m1;
+    const double central4 = e4 - 4.0 * m1 * e3 + 6.0 * m1 * m1 * e2 - 3.0 * m1 * m1 * m1 * m1;
+
+    features.mean = m1;
+    features.variance = central2;
+    features.skewness = central3 / std::pow(central2, 1.5);  // Skewness formula
+    features.kurtosis = central4 / (central2 * central2);    // Kurtosis formula
+    return features;
+}
+
+namespace {
+    // Turns the mean and the central moments into the feature set
+    StatisticalFeatures fromCentralMoments(double mean, double central2, double central3, double central4) {
+        StatisticalFeatures features;
+        features.mean = mean;
+        features.variance = central2;
+        features.skewness = central3 / std::pow(central2, 1.5);  // Skewness formula
+        features.kurtosis = central4 / (central2 * central2);    // Kurtosis formula
+        return features;
+    }
+
+    // Histogram path for 8-bit pixels: exact central moments from at most 256 distinct values
+    StatisticalFeatures statisticsFromHistogram(const cv::Mat& image) {
+        uint32_t histogram[256] = {};
+        for (int i = 0; i < image.rows; ++i) {
+            const uchar* pixels = image.ptr<uchar>(i);
+            for (int j = 0; j < image.cols; ++j) {
+                ++histogram[pixels[j]];
+            }
+        }
+
+        const double n = static_cast<double>(image.total());
+        double mean = 0.0;
+        for (int value = 0; value < 256; ++value) {
+            mean += static_cast<double>(value) * histogram[value];
+        }
+        mean /= n;
+
+        double central[3] = { 0.0, 0.0, 0.0 };
+        for (int value = 0; value < 256; ++value) {
+            if (histogram[value] == 0) {
+                continue;
+            }
+            const double d = value - mean;
+            const double d2 = d * d;
+            central[0] += d2 * histogram[value];
+            central[1] += d2 * d * histogram[value];
+            central[2] += d2 * d2 * histogram[value];
+        }
+        return fromCentralMoments(mean, central[0] / n, central[1] / n, central[2] / n);
+    }
+
+    // Power-sum path for wider pixel types, shifted by the first pixel value to limit cancellation
+    template <typename T>
+    StatisticalFeatures statisticsFromPowerSums(const cv::Mat& image) {
+        const double shift = image.ptr<T>(0)[0];
+        double sum[4] = { 0.0, 0.0, 0.0, 0.0 };
+        for (int i = 0; i < image.rows; ++i) {
+            const T* pixels = image.ptr<T>(i);
+            for (int j = 0; j < image.cols; ++j) {
+                const double d = pixels[j] - shift;
+                const double d2 = d * d;
+                sum[0] += d;
+                sum[1] += d2;
+                sum[2] += d2 * d;
+                sum[3] += d2 * d2;
+            }
+        }
+
+        const double n = static_cast<double>(image.total());
+        const double m1 = sum[0] / n;  // Mean relative to the shift
+        const double e2 = sum[1] / n;
+        const double e3 = sum[2] / n;
+        const double e4 = sum[3] / n;
+        return fromCentralMoments(shift + m1,
+            e2 - m1 * m1,
+            e3 - 3.0 * m1 * e2 + 2.0 * m1 * m1 * m1,
+            e4 - 4.0 * m1 * e3 + 6.0 * m1 * m1 * e2 - 3.0 * m1 * m1 * m1 * m1);
+    }
+}
+
+// Dispatches on the pixel depth once per image, not per pixel
+StatisticalFeatures computeStatisticalFeatures(const cv::Mat& image) {
+    if (image.empty() || image.channels() != 1) {
+        return StatisticalFeatures();
+    }
+
+    switch (image.depth()) {
+    case CV_8U:
+        return statisticsFromHistogram(image);
+    case CV_16U:
+        return statisticsFromPowerSums<ushort>(image);
+    case CV_16S:
+        return statisticsFromPowerSums<short>(image);
+    case CV_32F:
+        return statisticsFromPowerSums<float>(image);
+    case CV_64F:
+        return statisticsFromPowerSums<double>(image);
+    default:
+        return StatisticalFeatures();
+    }
+}
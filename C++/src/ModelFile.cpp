@@ -0,0 +1,196 @@
+#include "ModelFile.h"
+#include "ColorTransform.h"
+#include "GrayLevelQuantizer.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MODELFILE_HAS_MMAP 1
+#endif
+
+static const char kModelMagic[8] = { 'L', 'D', 'C', 'M', 'O', 'D', 'E', 'L' };
+
+// Bytes of the label section, padded so the feature store stays 8-byte aligned
+static size_t labelBytes(size_t count) {
+    return (count * sizeof(int32_t) + 7) / 8 * 8;
+}
+
+size_t ModelFile::pairsOffset() const {
+    return sizeof(ModelFileHeader) + header().classCount * sizeof(ModelClassRecord);
+}
+
+size_t ModelFile::labelsOffset() const {
+    return pairsOffset() + header().pairCount * sizeof(ModelPairRecord);
+}
+
+size_t ModelFile::featuresOffset() const {
+    return labelsOffset() + labelBytes(storeCount());
+}
+
+ModelFile::~ModelFile() {
+    close();
+}
+
+void ModelFile::close() {
+#ifdef MODELFILE_HAS_MMAP
+    if (data != nullptr && buffer.empty()) {
+        munmap(const_cast<char*>(data), size);
+    }
+#endif
+    buffer.clear();
+    data = nullptr;
+    size = 0;
+}
+
+// Maps the file and checks that its header matches this build and that every section lies within the file
+bool ModelFile::open(const std::string& path) {
+    close();
+
+#ifdef MODELFILE_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Cannot open model file " << path << std::endl;
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size < static_cast<off_t>(sizeof(ModelFileHeader))) {
+        std::cerr << "Model file " << path << " is truncated." << std::endl;
+        ::close(fd);
+        return false;
+    }
+    size = static_cast<size_t>(file_stat.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // The mapping keeps the file alive
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Cannot map model file " << path << std::endl;
+        size = 0;
+        return false;
+    }
+    data = static_cast<const char*>(mapping);
+#else
+    // No mmap: read the file into an 8-byte aligned buffer, which the accessors use the same way
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        std::cerr << "Cannot open model file " << path << std::endl;
+        return false;
+    }
+    size = static_cast<size_t>(in.tellg());
+    if (size < sizeof(ModelFileHeader)) {
+        std::cerr << "Model file " << path << " is truncated." << std::endl;
+        size = 0;
+        return false;
+    }
+    buffer.resize((size + sizeof(double) - 1) / sizeof(double));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(size));
+    data = reinterpret_cast<const char*>(buffer.data());
+#endif
+
+    const ModelFileHeader& h = header();
+    const char* problem = nullptr;
+    if (std::memcmp(h.magic, kModelMagic, sizeof(kModelMagic)) != 0) {
+        problem = "is not a model file";
+    }
+    else if (h.byteOrder != kModelFileByteOrder) {
+        problem = "was written on a host of the other byte order";
+    }
+    else if (h.version != kModelFileVersion) {
+        problem = "has an unsupported version";
+    }
+    else if (h.featureCount != static_cast<uint32_t>(kFeatureCount) || h.featureSetCount < 0 || h.featureSetCount > kFeatureCount) {
+        problem = "was written for a different feature set";
+    }
+    else if (h.classCount > (size - sizeof(ModelFileHeader)) / sizeof(ModelClassRecord)
+        || h.pairCount > size / sizeof(ModelPairRecord) || h.storeCount > size / sizeof(FeatureVector)
+        || featuresOffset() + storeCount() * sizeof(FeatureVector) != size) {
+        problem = "is truncated or has trailing data";
+    }
+    if (problem != nullptr) {
+        std::cerr << "Model file " << path << ' ' << problem << '.' << std::endl;
+        close();
+        return false;
+    }
+
+    // Header indices and enums are used without further checks, so every value must be in range
+    bool valid_settings = h.extractionLevels >= 2 && h.extractionLevels <= 256
+        && (h.extractionMode == static_cast<int32_t>(QuantizationMode::Uniform)
+            || h.extractionMode == static_cast<int32_t>(QuantizationMode::Equalized))
+        && h.extractionColor >= static_cast<int8_t>(ColorTransform::Luma)
+        && h.extractionColor <= static_cast<int8_t>(ColorTransform::Channel)
+        && h.extractionChannel >= 0 && h.extractionBitDepth >= 0 && h.extractionBitDepth <= 16;
+    for (int k = 0; valid_settings && k < h.featureSetCount; ++k) {
+        valid_settings = h.featureSet[k] >= 0 && h.featureSet[k] < kFeatureCount;
+    }
+    if (!valid_settings) {
+        std::cerr << "Model file " << path << " has invalid feature or extraction settings." << std::endl;
+        close();
+        return false;
+    }
+
+    // Records are indexed without further checks, so every index they hold must be in range
+    for (uint32_t p = 0; p < h.pairCount; ++p) {
+        const ModelPairRecord& pair = pairs()[p];
+        bool valid = pair.classI >= 0 && pair.classI < static_cast<int32_t>(h.classCount)
+            && pair.classJ >= 0 && pair.classJ < static_cast<int32_t>(h.classCount)
+            && pair.featureCount >= 0 && pair.featureCount <= kFeatureCount;
+        for (int k = 0; valid && k < pair.featureCount; ++k) {
+            valid = pair.features[k] >= 0 && pair.features[k] < kFeatureCount;
+        }
+        if (!valid) {
+            std::cerr << "Model file " << path << " has an invalid class pair." << std::endl;
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes all sections in order behind a completed header
+bool ModelFile::write(const std::string& path, const ModelFileHeader& header,
+    const std::vector<ModelClassRecord>& classes, const std::vector<ModelPairRecord>& pairs,
+    const std::vector<int32_t>& storeLabels, const std::vector<FeatureVector>& storeFeatures) {
+    if (storeLabels.size() != storeFeatures.size()) {
+        std::cerr << "Feature store labels and features differ in size." << std::endl;
+        return false;
+    }
+
+    ModelFileHeader h = header;
+    std::memcpy(h.magic, kModelMagic, sizeof(kModelMagic));
+    h.version = kModelFileVersion;
+    h.byteOrder = kModelFileByteOrder;
+    h.featureCount = kFeatureCount;
+    h.classCount = static_cast<uint32_t>(classes.size());
+    h.pairCount = static_cast<uint32_t>(pairs.size());
+    h.storeCount = storeFeatures.size();
+
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Cannot write model file " << temporary << std::endl;
+            return false;
+        }
+        const char padding[8] = {};
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(classes.data()), classes.size() * sizeof(ModelClassRecord));
+        out.write(reinterpret_cast<const char*>(pairs.data()), pairs.size() * sizeof(ModelPairRecord));
+        out.write(reinterpret_cast<const char*>(storeLabels.data()), storeLabels.size() * sizeof(int32_t));
+        out.write(padding, labelBytes(storeLabels.size()) - storeLabels.size() * sizeof(int32_t));
+        out.write(reinterpret_cast<const char*>(storeFeatures.data()), storeFeatures.size() * sizeof(FeatureVector));
+        if (!out.flush()) {
+            std::cerr << "Cannot write model file " << temporary << std::endl;
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::cerr << "Cannot replace model file " << path << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
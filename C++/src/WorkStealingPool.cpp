@@ -0,0 +1,144 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+namespace {
+    thread_local const WorkStealingPool* currentPool = nullptr;  // Pool the calling thread works for, if any
+    thread_local long currentWorker = -1;  // Queue index of the calling worker thread in currentPool, -1 for other threads
+}
+
+// Constructor: Creates one queue per worker plus one for external callers and starts the workers
+WorkStealingPool::WorkStealingPool(unsigned ThreadCount)
+{
+    size_t worker_count = ThreadCount > 1 ? ThreadCount - 1 : 0;
+    for (size_t i = 0; i <= worker_count; ++i) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+// Destructor: Lets the workers drain their queues, then joins them
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Executes the indices of one chunk and marks it finished
+void WorkStealingPool::runTask(const Task& task)
+{
+    Job* job = task.job;
+    try {
+        for (size_t i = task.begin; i < task.end; ++i) {
+            (*job->body)(i);
+        }
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(job->errorMutex);
+        if (!job->error) {
+            job->error = std::current_exception();
+        }
+    }
+
+    if (job->remaining.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        doneCondition.notify_all();
+    }
+}
+
+// Pops the newest task of queue home, or steals the oldest task of another queue
+bool WorkStealingPool::tryRunTask(size_t home)
+{
+    Task task{ 0, 0, nullptr };
+    for (size_t k = 0; k < queues.size() && task.job == nullptr; ++k) {
+        size_t index = (home + k) % queues.size();
+        WorkerQueue& queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (k == 0) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        else {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        queuedTasks.fetch_sub(1);
+    }
+
+    if (task.job == nullptr) {
+        return false;
+    }
+    runTask(task);
+    return true;
+}
+
+// Worker thread: runs tasks while any are queued, sleeps otherwise
+void WorkStealingPool::workerLoop(size_t index)
+{
+    currentPool = this;
+    currentWorker = static_cast<long>(index);
+    while (true) {
+        if (tryRunTask(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait(lock, [&] { return stopping || queuedTasks.load() > 0; });
+        if (stopping && queuedTasks.load() == 0) {
+            return;
+        }
+    }
+}
+
+// Splits [0, count) into chunks, spreads them over all queues and helps executing them until the job is done
+void WorkStealingPool::parallelFor(size_t count, const std::function<void(size_t)>& body, size_t Grain)
+{
+    if (count == 0) {
+        return;
+    }
+
+    size_t grain = std::max<size_t>(Grain, 1);
+    Job job;
+    job.body = &body;
+    job.remaining = (count + grain - 1) / grain;
+
+    // A worker of this pool keeps using its own queue; external threads, workers of other pools included,
+    // use the shared one
+    size_t home = currentPool == this && currentWorker >= 0 ? static_cast<size_t>(currentWorker) : queues.size() - 1;
+    size_t target = home;
+    for (size_t begin = 0; begin < count; begin += grain) {
+        WorkerQueue& queue = *queues[target];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(Task{ begin, std::min(begin + grain, count), &job });
+        }
+        queuedTasks.fetch_add(1);
+        target = (target + 1) % queues.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wakeCondition.notify_all();
+    doneCondition.notify_all();
+
+    while (job.remaining.load() > 0) {
+        if (tryRunTask(home)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        doneCondition.wait(lock, [&] { return job.remaining.load() == 0 || queuedTasks.load() > 0; });
+    }
+
+    if (job.error) {
+        std::rethrow_exception(job.error);
+    }
+}
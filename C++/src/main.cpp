@@ -1,36 +1,301 @@
 #include "BayesianDefectClassifier.h"
+#include "DefectLocalizer.h"
 #include "ImageTextureFeatures.h"
+#include "InspectionPipeline.h"
+#include "Instrumentation.h"
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 
-int main() {
-    // Define the feature set
-    /*
-    std::vector<std::string> feature_set = { "mean", "variance", "skewness", "kurtosis", "inertia", "cluster_shade", "cluster_prominence", "local_homogeneity", "energy", "entropy" };
+namespace fs = std::filesystem;
 
-    // Create a DefectDetection object
-    BayesianDefectClassifier classifier(feature_set);
+namespace {
+    void printUsage() {
+        std::cerr << "Usage: defect_classifier (<reference_dir> | <model_file>) (<image_dir> | --raw <width>x<height>) [options]\n"
+            << "  <reference_dir>     one sub-directory of grayscale patches per class; \"Clear area\" holds clear wood\n"
+            << "  <model_file>        model written by --save-model; its extraction settings override the options\n"
+            << "  <image_dir>         board images to inspect, processed in file name order\n"
+            << "  --raw WxH           read frames of W x H pixels from stdin instead: 8-bit, or 16-bit with --bit-depth above 8\n"
+            << "  --tile N            tile size in pixels (default 64)\n"
+            << "  --stride N          tile stride in pixels (default: tile size)\n"
+            << "  --angle A           co-occurrence angle in degrees (default 0)\n"
+            << "  --distance D        co-occurrence distance in pixels (default 1)\n"
+            << "  --levels N          gray levels of the co-occurrence matrix (default 256)\n"
+            << "  --bit-depth N       significant bits of 16-bit images, e.g. 12 (default: full 16-bit range)\n"
+            << "  --color C           reduction of color images: luma (default, decoded as grayscale), average or channel:N\n"
+            << "  --localize          print merged defect regions per frame instead of tiles, refining the tiles on\n"
+            << "                      defect outlines coarse-to-fine\n"
+            << "  --min-tile N        smallest refined tile with --localize, in pixels (default 16)\n"
+            << "  --clear-threshold T isClearArea threshold; negative disables the pre-filter (default -1)\n"
+            << "  --cascade R         reject clear wood on statistical features first, calibrated to recall R (e.g. 0.95)\n"
+            << "  --workers N         feature extraction threads (default: cores - 4, at least 1)\n"
+            << "  --queue N           capacity of every stage queue (default 64)\n"
+            << "  --save-model F      write the trained model and its reference features to F\n"
+            << "  --metrics F         append a JSON metrics snapshot to F periodically (needs ENABLE_INSTRUMENTATION)\n"
+            << "  --metrics-interval S seconds between metrics snapshots (default 10)" << std::endl;
+    }
 
-    // Create some defects and add them to the classifier
-    auto noDefect = std::make_shared<ImageTextureFeatures>("Clear area");
-    noDefect-> imageSection = cv2.imread("section_of_the_image_where_there_is_no_defect", cv2.IMREAD_GRAYSCALE);
+    // Lists the regular files of a directory in name order
+    std::vector<fs::path> listFiles(const fs::path& directory) {
+        std::vector<fs::path> files;
+        for (const auto& entry : fs::directory_iterator(directory)) {
+            if (entry.is_regular_file()) {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
 
-    auto defect1 = std::make_shared<ImageTextureFeatures>("Defect A");
-    defect1-> imageSection = cv2.imread("the section of the image where defect1 is present", cv2.IMREAD_GRAYSCALE)
+    // Adds every patch of <reference_dir>/<class>/ to the classifier as a sample of that class
+    void loadReferences(const fs::path& directory, const ExtractionSettings& settings, int readFlags, BayesianDefectClassifier& classifier) {
+        for (const auto& entry : fs::directory_iterator(directory)) {
+            if (!entry.is_directory()) {
+                continue;
+            }
+            std::string class_name = entry.path().filename().string();
+            for (const auto& file : listFiles(entry.path())) {
+                cv::Mat patch = cv::imread(file.string(), readFlags);
+                if (patch.empty()) {
+                    continue;
+                }
+                classifier.defects.push_back(std::make_shared<ImageTextureFeatures>(patch, class_name, settings));
+            }
+        }
+    }
+}
 
-    auto defect2 = std::make_shared<ImageTextureFeatures>("Defect B");
-    defect2-> imageSection = cv2.imread("the section of the image where defect2 is present", cv2.IMREAD_GRAYSCALE)
-    .
-    .
-    .
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
 
-    classifier.defects.push_back(defect1);
-    classifier.defects.push_back(defect2);
+    fs::path reference_dir = argv[1];
+    fs::path image_dir;
+    int raw_width = 0;
+    int raw_height = 0;
+    PipelineSettings settings;
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    settings.extractionWorkers = cores > 4 ? cores - 4 : 1;
+    bool stride_given = false;
+    double cascade_recall = -1.0;
+    std::string save_model;
+    std::string metrics_file;
+    double metrics_interval = 10.0;
+    bool localize = false;
+    int min_tile = 16;
 
-    // Classify defects
-    std::map<std::string, double> region_features = { {"mean", 7.0}, {"variance", 2.5} };
-    std::string result = classifier.classifyLumberDefect(region_features);
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--raw" && has_value) {
+            std::string size = argv[++i];
+            size_t x = size.find('x');
+            if (x == std::string::npos) {
+                printUsage();
+                return 1;
+            }
+            raw_width = std::stoi(size.substr(0, x));
+            raw_height = std::stoi(size.substr(x + 1));
+        }
+        else if (arg == "--tile" && has_value) {
+            settings.tileSize = std::stoi(argv[++i]);
+        }
+        else if (arg == "--stride" && has_value) {
+            settings.tileStride = std::stoi(argv[++i]);
+            stride_given = true;
+        }
+        else if (arg == "--angle" && has_value) {
+            settings.extraction.angle = std::stod(argv[++i]);
+        }
+        else if (arg == "--distance" && has_value) {
+            settings.extraction.distance = std::stod(argv[++i]);
+        }
+        else if (arg == "--levels" && has_value) {
+            settings.extraction.levels = std::stoi(argv[++i]);
+        }
+        else if (arg == "--bit-depth" && has_value) {
+            settings.extraction.bitDepth = std::min(16, std::max(0, std::stoi(argv[++i])));
+        }
+        else if (arg == "--color" && has_value) {
+            std::string color = argv[++i];
+            if (color == "luma") {
+                settings.extraction.color = ColorTransform::Luma;
+            }
+            else if (color == "average") {
+                settings.extraction.color = ColorTransform::Average;
+            }
+            else if (color.rfind("channel:", 0) == 0) {
+                settings.extraction.color = ColorTransform::Channel;
+                settings.extraction.channel = std::stoi(color.substr(8));
+            }
+            else {
+                printUsage();
+                return 1;
+            }
+        }
+        else if (arg == "--localize") {
+            localize = true;
+        }
+        else if (arg == "--min-tile" && has_value) {
+            min_tile = std::stoi(argv[++i]);
+        }
+        else if (arg == "--clear-threshold" && has_value) {
+            settings.clearThreshold = std::stod(argv[++i]);
+        }
+        else if (arg == "--cascade" && has_value) {
+            cascade_recall = std::stod(argv[++i]);
+        }
+        else if (arg == "--save-model" && has_value) {
+            save_model = argv[++i];
+        }
+        else if (arg == "--metrics" && has_value) {
+            metrics_file = argv[++i];
+        }
+        else if (arg == "--metrics-interval" && has_value) {
+            metrics_interval = std::max(0.1, std::stod(argv[++i]));
+        }
+        else if (arg == "--workers" && has_value) {
+            settings.extractionWorkers = static_cast<unsigned>(std::max(1, std::stoi(argv[++i])));
+        }
+        else if (arg == "--queue" && has_value) {
+            settings.queueCapacity = static_cast<size_t>(std::max(1, std::stoi(argv[++i])));
+        }
+        else if (image_dir.empty() && arg.rfind("--", 0) != 0) {
+            image_dir = arg;
+        }
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (!stride_given) {
+        settings.tileStride = settings.tileSize;
+    }
+    if (image_dir.empty() && raw_width <= 0) {
+        printUsage();
+        return 1;
+    }
 
-    std::cout << "Classified as: " << result << std::endl;
+    // Images keep their bit depth. Color is kept for the average and single-channel transforms, which
+    // differ from the luma the decoder produces; flags follow the settings of a loaded model.
+    auto readFlags = [](const ExtractionSettings& extraction) {
+        return cv::IMREAD_ANYDEPTH | (extraction.color != ColorTransform::Luma ? cv::IMREAD_ANYCOLOR : 0);
+    };
 
+    // Load a saved model, or train once on the reference patches
+    BayesianDefectClassifier classifier(featureNames());
+    int read_flags = readFlags(settings.extraction);
+    if (fs::is_regular_file(reference_dir)) {
+        if (!classifier.loadModel(reference_dir.string(), settings.extraction)) {
+            return 1;
+        }
+        read_flags = readFlags(settings.extraction);
+    }
+    else {
+        loadReferences(reference_dir, settings.extraction, read_flags, classifier);
+        classifier.train();
+    }
+    if (classifier.classModels.empty()) {
+        std::cerr << "No defect classes found in " << reference_dir << std::endl;
+        return 1;
+    }
+    if (cascade_recall >= 0.0 && !classifier.clearWoodSamples.empty()) {
+        classifier.calibrateClearCascade(cascade_recall);
+    }
+    if (cascade_recall >= 0.0 && classifier.clearCascade.enabled) {
+        settings.cascade = true;
+        std::cerr << "Clear-wood cascade: threshold " << classifier.clearCascade.threshold
+            << ", training recall " << classifier.clearCascade.recall << std::endl;
+    }
+    if (!save_model.empty() && !classifier.saveModel(save_model, settings.extraction)) {
+        return 1;
+    }
+
+    // Frame source: image files of a directory or raw frames from stdin
+    std::vector<fs::path> files;
+    size_t next_file = 0;
+    if (!image_dir.empty()) {
+        files = listFiles(image_dir);
+    }
+    std::function<bool(BoardFrame&)> source = [&](BoardFrame& frame) {
+        if (raw_width > 0) {
+            frame.image.create(raw_height, raw_width, settings.extraction.bitDepth > 8 ? CV_16UC1 : CV_8UC1);
+            frame.source = "stdin";
+            return static_cast<bool>(std::cin.read(reinterpret_cast<char*>(frame.image.data),
+                static_cast<std::streamsize>(frame.image.total() * frame.image.elemSize())));
+        }
+        while (next_file < files.size()) {
+            frame.source = files[next_file].filename().string();
+            frame.image = cv::imread(files[next_file++].string(), read_flags);
+            if (!frame.image.empty()) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // One CSV line per defect region: frame, source, bounding box, label, confidence, area in pixels
+    if (localize) {
+        LocalizationSettings localization;
+        localization.extraction = settings.extraction;
+        localization.tileSize = settings.tileSize;
+        localization.minTileSize = min_tile;
+        localization.cascade = settings.cascade;
+        localization.clearThreshold = settings.clearThreshold;
+        DefectLocalizer localizer(classifier, localization);
+        WorkStealingPool pool(settings.extractionWorkers);
+
+        std::cout << "frame,source,x,y,width,height,label,confidence,area" << std::endl;
+        BoardFrame frame;
+        size_t classified_tiles = 0;
+        size_t map_cells = 0;
+        while (source(frame)) {
+            DefectMap map = localizer.localize(frame.image, pool);
+            for (const DefectRegion& region : map.regions) {
+                std::cout << frame.index << ',' << frame.source << ',' << region.box.x << ',' << region.box.y << ','
+                    << region.box.width << ',' << region.box.height << ',' << region.name << ','
+                    << region.confidence << ',' << region.area << '\n';
+            }
+            classified_tiles += map.classifiedTiles;
+            map_cells += map.labels.total();
+            ++frame.index;
+        }
+        std::cout << std::flush;
+        std::cerr << "Localized " << frame.index << " frames: " << classified_tiles << " tiles classified for "
+            << map_cells << " map cells of " << localizer.getCellSize() << " pixels" << std::endl;
+        return 0;
+    }
+
+    // One CSV line per tile: frame, source, x, y, width, height, label
+    std::cout << "frame,source,x,y,width,height,label" << std::endl;
+    InspectionPipeline pipeline(classifier, settings);
+    {
+        // Training is not part of the inspection metrics
+        resetMetrics();
+        std::ofstream metrics_out;
+        std::unique_ptr<MetricsReporter> reporter;
+        if (!metrics_file.empty()) {
+            metrics_out.open(metrics_file, std::ios::app);
+            reporter.reset(new MetricsReporter(std::chrono::milliseconds(static_cast<long long>(metrics_interval * 1000)),
+                [&](const std::vector<MetricSnapshot>& snapshot) { writeMetricsJson(metrics_out, snapshot); }));
+        }
+        pipeline.run(source, [](const TileResult& result) {
+            std::cout << result.frame << ',' << result.source << ','
+                << result.rect.x << ',' << result.rect.y << ',' << result.rect.width << ',' << result.rect.height << ','
+                << result.label << '\n';
+        });
+    }
+
+    pipeline.reportThroughput(std::cerr);
+    if (kInstrumentationEnabled) {
+        writeMetricsText(std::cerr, snapshotMetrics());
+    }
     return 0;
-    */
-}
\ No newline at end of file
+}
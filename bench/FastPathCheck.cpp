@@ -0,0 +1,382 @@
+// Regression check of the fast feature paths against the direct computation on synthetic wood boards:
+//  - BoardTextureScanner, whose windows are updated incrementally, against ImageTextureFeatures per window
+//  - accumulateCooccurrence, with its SIMD kernels and private histograms, against a plain pair count
+//  - IntegralStatistics::regionFeatures, from summed-area tables and the integral histogram, against
+//    ImageTextureFeatures per rectangle
+// Boards have odd sizes, and the windows and rectangles include those touching the board edge.
+// The exact texture sums must not overflow on a board large enough to push the fourth-power sum past int64_t.
+// Input the extraction rejects must give NaN features on every path, never uninitialized values.
+// Batch classification (blocked likelihoods) must vote exactly as one region at a time, close votes included.
+// Prints one summary line per path and exits non-zero on any mismatch; registered with ctest.
+#include "SyntheticWood.h"
+#include "BayesianDefectClassifier.h"
+#include "BoardTextureScanner.h"
+#include "CooccurrenceKernels.h"
+#include "ExtractionContext.h"
+#include "ImageTextureFeatures.h"
+#include "IntegralStatistics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    // Relative tolerance of the floating-point features; the fast paths sum the same integers in another order
+    const double kTolerance = 1e-8;
+
+    // Boards of every kind with odd, non-square sizes
+    struct BoardCase {
+        int rows;
+        int cols;
+        WoodKind kind;
+        unsigned seed;
+    };
+    const BoardCase kBoards[] = {
+        { 61, 149, WoodKind::Knot, 11 },
+        { 45, 77, WoodKind::Split, 12 },
+        { 23, 31, WoodKind::Stain, 13 },
+        { 33, 97, WoodKind::Clear, 14 },
+    };
+
+    // Co-occurrence offsets with positive, negative and mixed displacements
+    const CooccurrenceOffset kOffsets[] = { { 0.0, 1.0 }, { 45.0, 1.0 }, { 90.0, 2.0 }, { 135.0, 3.0 }, { 180.0, 1.0 }, { 270.0, 2.0 } };
+
+    // Largest relative difference over the ten features; NaN only matches NaN
+    double featureError(const FeatureVector& fast, const FeatureVector& direct) {
+        double worst = 0.0;
+        for (int k = 0; k < kFeatureCount; ++k) {
+            const double a = fast[k];
+            const double b = direct[k];
+            if (std::isnan(a) || std::isnan(b)) {
+                if (std::isnan(a) != std::isnan(b)) {
+                    return std::numeric_limits<double>::infinity();
+                }
+                continue;
+            }
+            worst = std::max(worst, std::abs(a - b) / std::max({ 1.0, std::abs(a), std::abs(b) }));
+        }
+        return worst;
+    }
+
+    // Running result of one fast path
+    struct CheckResult {
+        std::string name;
+        double tolerance = kTolerance;
+        size_t cases = 0;
+        size_t failures = 0;
+        double worstError = 0.0;
+
+        // Records one comparison and prints the first few failing cases
+        void record(double error, const std::string& where) {
+            cases += 1;
+            worstError = std::max(worstError, error);
+            if (!(error <= tolerance)) {
+                if (failures < 5) {
+                    std::cerr << name << " mismatch at " << where << ": relative error " << error << std::endl;
+                }
+                failures += 1;
+            }
+        }
+
+        // Prints the summary line; true when every case matched
+        bool report() const {
+            std::cout << name << ": " << cases << " cases, " << failures << " failures, max relative error "
+                << worstError << std::endl;
+            return failures == 0;
+        }
+    };
+
+    std::string describe(const BoardCase& board, const CooccurrenceOffset& offset, int levels) {
+        return std::to_string(board.rows) + "x" + std::to_string(board.cols) + " board, angle "
+            + std::to_string(offset.angle) + ", distance " + std::to_string(offset.distance)
+            + ", " + std::to_string(levels) + " levels";
+    }
+
+    std::string describe(const cv::Rect& rect) {
+        return "rect " + std::to_string(rect.x) + "," + std::to_string(rect.y) + " "
+            + std::to_string(rect.width) + "x" + std::to_string(rect.height);
+    }
+
+    // Every window of the scanner's feature map against ImageTextureFeatures on the same window. Stride 1
+    // and strides that divide the free space reach the right and bottom edges; the others stop short.
+    bool checkBoardScanner() {
+        struct WindowCase {
+            int rows;
+            int cols;
+            int stride;
+        };
+        const WindowCase windows[] = { { 9, 13, 1 }, { 21, 25, 4 }, { 17, 23, 7 }, { 23, 31, 3 } };
+        const int levels_list[] = { 256, 37 };
+
+        CheckResult result{ "BoardTextureScanner" };
+        for (const BoardCase& board_case : kBoards) {
+            const cv::Mat board = makeWoodPatch(board_case.rows, board_case.cols, board_case.kind, board_case.seed);
+            for (const WindowCase& window : windows) {
+                if (window.rows > board.rows || window.cols > board.cols) {
+                    continue;
+                }
+                const int positions = ((board.rows - window.rows) / window.stride + 1) * ((board.cols - window.cols) / window.stride + 1);
+                if (window.stride == 1 && positions > 400) {
+                    continue;  // Stride 1 on the small boards only; every window costs a full extraction
+                }
+                for (const CooccurrenceOffset& offset : kOffsets) {
+                    for (int levels : levels_list) {
+                        BoardTextureScanner scanner(board, window.rows, window.cols, window.stride, offset.angle, offset.distance, levels);
+                        const cv::Mat feature_map = scanner.scan();
+                        for (int r = 0; r < feature_map.rows; ++r) {
+                            for (int c = 0; c < feature_map.cols; ++c) {
+                                const cv::Rect rect(c * window.stride, r * window.stride, window.cols, window.rows);
+                                ImageTextureFeatures direct(board(rect), "", offset.angle, offset.distance, levels);
+                                result.record(featureError(BoardTextureScanner::windowFeatureVector(feature_map, r, c), direct.getFeatureVector()),
+                                    describe(board_case, offset, levels) + ", window " + describe(rect));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return result.report();
+    }
+
+    // Pair counts and reported non-zero cells of the kernel against a plain loop, for level counts on both
+    // sides of every private histogram count and offsets up to larger than the board. The kernel runs twice
+    // per case into the same histogram, so private histograms it failed to clear after the first run show
+    // up in the second, as do cells reported again although they were already non-zero.
+    bool checkCooccurrenceKernel() {
+        const int levels_list[] = { 2, 7, 37, 64, 65, 77, 90, 91, 128, 200, 256 };
+        const int shifts[][2] = { { 0, 1 }, { 1, 0 }, { 1, 1 }, { -1, 2 }, { 2, -3 }, { -4, -1 }, { 0, -5 }, { 70, 0 }, { 0, 160 } };
+
+        CheckResult result{ "accumulateCooccurrence" };
+        for (const BoardCase& board_case : kBoards) {
+            const cv::Mat board = makeWoodPatch(board_case.rows, board_case.cols, board_case.kind, board_case.seed);
+            for (int levels : levels_list) {
+                GrayLevelQuantizer quantizer(levels, QuantizationMode::Equalized);  // Spreads the pairs over all levels
+                quantizer.fit(board);
+                cv::Mat level_image;
+                quantizer.apply(board, level_image);
+                const size_t bins = static_cast<size_t>(levels) * levels;
+                for (const auto& shift : shifts) {
+                    const int dx = shift[0];
+                    const int dy = shift[1];
+                    std::vector<int32_t> expected(bins, 0);
+                    int64_t expected_pairs = 0;
+                    for (int i = 0; i < level_image.rows; ++i) {
+                        for (int j = 0; j < level_image.cols; ++j) {
+                            if (i + dx >= 0 && i + dx < level_image.rows && j + dy >= 0 && j + dy < level_image.cols) {
+                                ++expected[level_image.at<uchar>(i, j) * levels + level_image.at<uchar>(i + dx, j + dy)];
+                                ++expected_pairs;
+                            }
+                        }
+                    }
+                    std::vector<int> expected_cells;
+                    for (size_t cell = 0; cell < bins; ++cell) {
+                        if (expected[cell] != 0) {
+                            expected_cells.push_back(static_cast<int>(cell));
+                        }
+                    }
+                    // The second run adds onto the first: every count doubles and no cell turns non-zero
+                    std::vector<int32_t> counts(bins, 0);
+                    std::vector<int> cells;
+                    for (int run = 0; run < 2; ++run) {
+                        const int64_t pairs = accumulateCooccurrence(level_image, levels, dx, dy, counts.data(), cells);
+                        std::sort(cells.begin(), cells.end());
+                        bool same = pairs == expected_pairs && cells == expected_cells;
+                        for (size_t cell = 0; cell < bins; ++cell) {
+                            same = same && counts[cell] == (run + 1) * expected[cell];
+                        }
+                        result.record(same ? 0.0 : 1.0, std::to_string(board_case.rows) + "x" + std::to_string(board_case.cols)
+                            + " board, " + std::to_string(levels) + " levels, shift " + std::to_string(dx) + "," + std::to_string(dy)
+                            + ", run " + std::to_string(run + 1));
+                    }
+                }
+            }
+        }
+        return result.report();
+    }
+
+    // Rectangles of every shape against ImageTextureFeatures: the whole board, rectangles flush with each
+    // edge and corner, rectangles smaller than a grid cell and random odd-sized ones
+    bool checkIntegralStatistics() {
+        const int levels_list[] = { 16, 37 };
+        const int cell_sizes[] = { 8, 5 };
+
+        CheckResult result{ "IntegralStatistics" };
+        std::mt19937 rng(7);
+        for (const BoardCase& board_case : kBoards) {
+            const cv::Mat board = makeWoodPatch(board_case.rows, board_case.cols, board_case.kind, board_case.seed);
+            const int rows = board.rows;
+            const int cols = board.cols;
+            std::vector<cv::Rect> rects = {
+                cv::Rect(0, 0, cols, rows),
+                cv::Rect(0, 0, 13, 11),
+                cv::Rect(cols - 13, 0, 13, 11),
+                cv::Rect(0, rows - 11, 13, 11),
+                cv::Rect(cols - 13, rows - 11, 13, 11),
+                cv::Rect(cols - 19, 3, 19, rows - 3),
+                cv::Rect(5, 6, 3, 4),
+            };
+            for (int k = 0; k < 24; ++k) {
+                const int width = 3 + static_cast<int>(rng() % (cols - 2));
+                const int height = 3 + static_cast<int>(rng() % (rows - 2));
+                rects.push_back(cv::Rect(static_cast<int>(rng() % (cols - width + 1)), static_cast<int>(rng() % (rows - height + 1)), width, height));
+            }
+
+            IntegralStatistics integral(board);
+            for (const CooccurrenceOffset& offset : kOffsets) {
+                for (int levels : levels_list) {
+                    for (int cell_size : cell_sizes) {
+                        integral.buildCooccurrenceTable(levels, offset.angle, offset.distance, cell_size);
+                        for (const cv::Rect& rect : rects) {
+                            ImageTextureFeatures direct(board(rect), "", offset.angle, offset.distance, levels);
+                            result.record(featureError(integral.regionFeatures(rect), direct.getFeatureVector()),
+                                describe(board_case, offset, levels) + ", cell " + std::to_string(cell_size) + ", " + describe(rect));
+                        }
+                    }
+                }
+            }
+        }
+        return result.report();
+    }
+
+    // Cluster shade and prominence of a near-white 12500 x 12500 board at 256 levels against central moments
+    // computed in long double from a plain pair count. The board has 1.56e8 pairs with (i + j)^4 ~ 6e10 each,
+    // so the fourth-power sum is past the int64_t range. The raw-moment expansion of the features cancels
+    // terms of ~1e11 here, hence the looser tolerance.
+    bool checkLargeBoardSums() {
+        const int size = 12500;
+        cv::Mat board(size, size, CV_8U);
+        for (int i = 0; i < size; ++i) {
+            uchar* row = board.ptr<uchar>(i);
+            for (int j = 0; j < size; ++j) {
+                row[j] = static_cast<uchar>(240 + ((static_cast<uint32_t>(i) * 2654435761u ^ static_cast<uint32_t>(j) * 40503u) >> 13) % 16);
+            }
+        }
+
+        const CooccurrenceOffset offset{ 0.0, 1.0 };
+        const int dx = offset.rowShift();
+        const int dy = offset.colShift();
+        std::vector<int64_t> counts(256 * 256, 0);
+        for (int i = std::max(0, -dx); i < std::min(size, size - dx); ++i) {
+            const uchar* a = board.ptr<uchar>(i);
+            const uchar* b = board.ptr<uchar>(i + dx);
+            for (int j = std::max(0, -dy); j < std::min(size, size - dy); ++j) {
+                ++counts[a[j] * 256 + b[j + dy]];
+            }
+        }
+        long double pairs = 0.0L, sum_i = 0.0L, sum_j = 0.0L;
+        for (int cell = 0; cell < 256 * 256; ++cell) {
+            pairs += counts[cell];
+            sum_i += static_cast<long double>(cell / 256) * counts[cell];
+            sum_j += static_cast<long double>(cell % 256) * counts[cell];
+        }
+        const long double mu = (sum_i + sum_j) / pairs;
+        long double shade = 0.0L, prominence = 0.0L;
+        for (int cell = 0; cell < 256 * 256; ++cell) {
+            const long double d = cell / 256 + cell % 256 - mu;
+            shade += d * d * d * counts[cell] / pairs;
+            prominence += d * d * d * d * counts[cell] / pairs;
+        }
+
+        CheckResult result{ "Large-board sums", 1e-6 };
+        ImageTextureFeatures features(board, "", offset.angle, offset.distance, 256);
+        auto relative = [](double fast, long double exact) {
+            return static_cast<double>(std::abs(fast - exact) / std::max(1.0L, std::abs(exact)));
+        };
+        result.record(relative(features.getClusterShade(), shade), "cluster shade, " + std::to_string(size) + "x" + std::to_string(size));
+        result.record(relative(features.getClusterProminence(), prominence),
+            "cluster prominence, " + std::to_string(size) + "x" + std::to_string(size));
+        return result.report();
+    }
+
+    // Images of unsupported pixel types or channel counts through ImageTextureFeatures, ExtractionContext and
+    // extractBatch: every feature of every path must be NaN
+    bool checkRejectedInput() {
+        const cv::Mat rejected[] = { cv::Mat(19, 23, CV_64FC3, cv::Scalar(0.5)), cv::Mat(19, 23, CV_64F, cv::Scalar(0.5)), cv::Mat() };
+        auto all_nan = [](const FeatureVector& features) {
+            return std::all_of(features.values.begin(), features.values.end(), [](double value) { return std::isnan(value); });
+        };
+
+        CheckResult result{ "Rejected input" };
+        ExtractionContext context;
+        WorkStealingPool pool(2);
+        for (const cv::Mat& image : rejected) {
+            const std::string where = "type " + std::to_string(image.type()) + ", " + std::to_string(image.rows) + "x" + std::to_string(image.cols);
+            ImageTextureFeatures features(image, "", ExtractionSettings());
+            const bool statistics_nan = std::isnan(features.getMean()) && std::isnan(features.getVariance())
+                && std::isnan(features.getSkewness()) && std::isnan(features.getKurtosis());
+            result.record(statistics_nan && all_nan(features.getFeatureVector()) ? 0.0 : 1.0, "ImageTextureFeatures, " + where);
+            result.record(all_nan(context.extract(image)) ? 0.0 : 1.0, "ExtractionContext, " + where);
+            result.record(all_nan(ImageTextureFeatures::extractBatch({ image }, ExtractionSettings(), pool).front()) ? 0.0 : 1.0,
+                "extractBatch, " + where);
+        }
+        return result.report();
+    }
+
+    // Likelihoods and votes of the batch path against the single-region path on a classifier trained on
+    // synthetic patches. Besides the patches themselves, the regions include points on the segments
+    // between patches of different classes, where pairwise votes are close.
+    bool checkBatchClassification() {
+        BayesianDefectClassifier classifier(featureNames());
+        const int class_count = 6;
+        std::vector<FeatureVector> samples;
+        for (int c = 0; c < class_count; ++c) {
+            for (int s = 0; s < 8; ++s) {
+                cv::Mat patch = makeWoodPatch(48, 48, static_cast<WoodKind>(1 + c % 3), 1000u * c + s, 12.0 * (c / 3));
+                classifier.defects.push_back(std::make_shared<ImageTextureFeatures>(patch, "class" + std::to_string(c), 0.0, 1.0, 32));
+                samples.push_back(classifier.defects.back()->getFeatureVector());
+            }
+        }
+        WorkStealingPool pool(4);
+        classifier.train(pool);
+
+        std::vector<FeatureVector> regions = samples;
+        for (size_t a = 0; a < samples.size(); a += 3) {
+            const FeatureVector& from = samples[a];
+            const FeatureVector& to = samples[(a + 13) % samples.size()];
+            for (int step = 1; step < 40; ++step) {
+                FeatureVector point;
+                for (int k = 0; k < kFeatureCount; ++k) {
+                    point[k] = from[k] + (to[k] - from[k]) * step / 40.0;
+                }
+                regions.push_back(point);
+            }
+        }
+
+        CheckResult result{ "Batch classification" };
+        std::vector<double> batch(regions.size());
+        for (const ClassPairModel& pair : classifier.pairModels) {
+            for (const GaussianModel* model : { &pair.modelI, &pair.modelJ }) {
+                model->logLikelihoods(regions.data(), regions.size(), batch.data());
+                for (size_t r = 0; r < regions.size(); ++r) {
+                    result.record(model->logLikelihood(regions[r]) == batch[r] ? 0.0 : 1.0,
+                        "likelihood of region " + std::to_string(r) + ", classes " + std::to_string(pair.classI) + "/" + std::to_string(pair.classJ));
+                }
+            }
+        }
+
+        std::vector<int> indices;
+        classifier.predictClassIndices(regions, indices);
+        const std::vector<std::string> labels = classifier.classifyBatch(regions, pool);
+        for (size_t r = 0; r < regions.size(); ++r) {
+            const int single = classifier.predictClassIndex(regions[r]);
+            result.record(single == indices[r] && labels[r] == classifier.classModels[single].name ? 0.0 : 1.0,
+                "votes of region " + std::to_string(r));
+        }
+        return result.report();
+    }
+}
+
+int main() {
+    bool passed = checkBoardScanner();
+    passed = checkCooccurrenceKernel() && passed;
+    passed = checkIntegralStatistics() && passed;
+    passed = checkLargeBoardSums() && passed;
+    passed = checkRejectedInput() && passed;
+    passed = checkBatchClassification() && passed;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+#include "SyntheticWood.h"
+#include "ImageTextureFeatures.h"
+#include "ExtractionContext.h"
+#include "BayesianDefectClassifier.h"
+#include "WorkStealingPool.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+    // Reports pixels processed per second as megapixels per second
+    void setPixelRate(benchmark::State& state, double pixelsPerIteration) {
+        state.counters["MPixels"] = benchmark::Counter(pixelsPerIteration * state.iterations() / 1e6, benchmark::Counter::kIsRate);
+    }
+
+    // A fixed set of patches per (size, kind), so every run of a benchmark sees the same pixels
+    std::vector<cv::Mat> makePatches(int size, int count, unsigned seed) {
+        std::vector<cv::Mat> patches;
+        for (int p = 0; p < count; ++p) {
+            patches.push_back(makeWoodPatch(size, size, static_cast<WoodKind>(p % 4), seed + p));
+        }
+        return patches;
+    }
+
+    // Trained classifier with classCount classes of 8 samples each, built once per class count
+    BayesianDefectClassifier& trainedClassifier(int classCount) {
+        static std::map<int, std::unique_ptr<BayesianDefectClassifier>> classifiers;
+        std::unique_ptr<BayesianDefectClassifier>& classifier = classifiers[classCount];
+        if (!classifier) {
+            classifier.reset(new BayesianDefectClassifier(featureNames()));
+            for (int c = 0; c < classCount; ++c) {
+                WoodKind kind = static_cast<WoodKind>(1 + c % 3);
+                double brightness = 12.0 * (c / 3);
+                for (int s = 0; s < 8; ++s) {
+                    cv::Mat patch = makeWoodPatch(48, 48, kind, 1000u * c + s, brightness);
+                    classifier->defects.push_back(std::make_shared<ImageTextureFeatures>(patch, "class" + std::to_string(c), 0.0, 1.0, 32));
+                }
+            }
+            classifier->train();
+        }
+        return *classifier;
+    }
+}
+
+// Full extraction of one patch: statistical features, quantization, co-occurrence matrix and texture features.
+// Args: patch edge length, gray levels
+static void BM_ExtractFeatures(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int levels = static_cast<int>(state.range(1));
+    std::vector<cv::Mat> patches = makePatches(size, 16, 1);
+    size_t next = 0;
+    for (auto _ : state) {
+        ImageTextureFeatures features(patches[next++ % patches.size()], "", 0.0, 1.0, levels);
+        benchmark::DoNotOptimize(features.getFeatureVector());
+    }
+    setPixelRate(state, static_cast<double>(size) * size);
+}
+BENCHMARK(BM_ExtractFeatures)->ArgsProduct({ { 32, 64, 128, 256 }, { 16, 64, 256 } });
+
+// The same extraction through a reused ExtractionContext, which allocates nothing once warmed up.
+// Args: patch edge length, gray levels
+static void BM_ExtractFeaturesContext(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    ExtractionSettings settings;
+    settings.levels = static_cast<int>(state.range(1));
+    ExtractionContext context(settings);
+    std::vector<cv::Mat> patches = makePatches(size, 16, 1);
+    size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(context.extract(patches[next++ % patches.size()]));
+    }
+    setPixelRate(state, static_cast<double>(size) * size);
+}
+BENCHMARK(BM_ExtractFeaturesContext)->ArgsProduct({ { 32, 64, 128, 256 }, { 16, 64, 256 } });
+
+// One texture feature read on demand; energy needs the co-occurrence matrix but no logarithms.
+// Args: patch edge length, gray levels
+static void BM_SingleTextureFeature(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int levels = static_cast<int>(state.range(1));
+    std::vector<cv::Mat> patches = makePatches(size, 16, 2);
+    size_t next = 0;
+    for (auto _ : state) {
+        ImageTextureFeatures features(patches[next++ % patches.size()], "", 0.0, 1.0, levels);
+        benchmark::DoNotOptimize(features.getEnergy());
+    }
+    setPixelRate(state, static_cast<double>(size) * size);
+}
+BENCHMARK(BM_SingleTextureFeature)->ArgsProduct({ { 64, 256 }, { 16, 256 } });
+
+// Co-occurrence matrix and sums of an already constructed patch, alternating between two offsets so
+// every iteration rebuilds the matrix. Args: patch edge length, gray levels
+static void BM_CooccurrenceMatrix(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int levels = static_cast<int>(state.range(1));
+    ImageTextureFeatures features(makeWoodPatch(size, size, WoodKind::Knot, 3), "", 0.0, 1.0, levels);
+    bool vertical = false;
+    for (auto _ : state) {
+        features.setAngleandDistance(vertical ? 90.0 : 0.0, 1.0);
+        features.calculateCooccurrenceMatrix();
+        vertical = !vertical;
+    }
+    setPixelRate(state, static_cast<double>(size) * size);
+}
+BENCHMARK(BM_CooccurrenceMatrix)->ArgsProduct({ { 32, 64, 128, 256 }, { 16, 64, 256 } });
+
+// Texture features of several offsets from one pass over the patch. Arg: number of offsets
+static void BM_MultiOffsetFeatures(benchmark::State& state) {
+    const int offset_count = static_cast<int>(state.range(0));
+    ImageTextureFeatures features(makeWoodPatch(64, 64, WoodKind::Knot, 4), "", 0.0, 1.0, 32);
+    std::vector<CooccurrenceOffset> offsets;
+    for (int k = 0; k < offset_count; ++k) {
+        offsets.push_back(CooccurrenceOffset{ 45.0 * (k % 4), 1.0 + k / 4 });
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(features.calculateMultiOffsetFeatures(offsets));
+    }
+    state.counters["offsets"] = benchmark::Counter(static_cast<double>(offset_count) * state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_MultiOffsetFeatures)->Arg(1)->Arg(4)->Arg(8)->Arg(16);
+
+// Latency of one classifyLumberDefect() call on a trained model, with p50 and p99 over all calls of the run.
+// Every call is timed individually, which adds the clock overhead (tens of nanoseconds) to each sample.
+// Arg: number of classes
+static void BM_ClassifyLatency(benchmark::State& state) {
+    const int class_count = static_cast<int>(state.range(0));
+    BayesianDefectClassifier& classifier = trainedClassifier(class_count);
+
+    std::vector<FeatureVector> regions;
+    for (int p = 0; p < 64; ++p) {
+        cv::Mat patch = makeWoodPatch(48, 48, static_cast<WoodKind>(p % 4), 50000u + p, 12.0 * (p % 3));
+        regions.push_back(ImageTextureFeatures(patch, "", 0.0, 1.0, 32).getFeatureVector());
+    }
+
+    std::vector<double> latencies;
+    latencies.reserve(1 << 20);
+    size_t next = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        benchmark::DoNotOptimize(classifier.classifyLumberDefect(regions[next++ % regions.size()]));
+        auto stop = std::chrono::steady_clock::now();
+        if (latencies.size() < latencies.capacity()) {
+            latencies.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+        }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    if (!latencies.empty()) {
+        state.counters["p50_ns"] = latencies[latencies.size() / 2];
+        state.counters["p99_ns"] = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+    }
+    state.counters["pairs"] = static_cast<double>(classifier.pairModels.size());
+}
+BENCHMARK(BM_ClassifyLatency)->Arg(3)->Arg(6)->Arg(12)->Arg(24);
+
+// Heap memory held by one ImageTextureFeatures instance after all features are read, excluding the shared
+// patch pixels. Measured from the allocator's in-use bytes, which also sees cv::Mat buffers. Arg: gray levels
+static void BM_InstanceMemory(benchmark::State& state) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const int levels = static_cast<int>(state.range(0));
+    const int instance_count = 64;
+    std::vector<cv::Mat> patches = makePatches(64, instance_count, 5);
+    double bytes_per_instance = 0.0;
+    for (auto _ : state) {
+        std::vector<std::unique_ptr<ImageTextureFeatures>> instances;
+        instances.reserve(instance_count);
+        size_t before = mallinfo2().uordblks;
+        for (const cv::Mat& patch : patches) {
+            instances.emplace_back(new ImageTextureFeatures(patch, "", 0.0, 1.0, levels));
+            benchmark::DoNotOptimize(instances.back()->getFeatureVector());
+        }
+        size_t after = mallinfo2().uordblks;
+        bytes_per_instance = static_cast<double>(after - before) / instance_count;
+    }
+    state.counters["bytes_per_instance"] = bytes_per_instance;
+    state.counters["sizeof"] = static_cast<double>(sizeof(ImageTextureFeatures));
+#else
+    state.SkipWithError("Heap usage needs glibc 2.33 or later (mallinfo2)");
+#endif
+}
+BENCHMARK(BM_InstanceMemory)->Arg(16)->Arg(64)->Arg(256)->Iterations(4);
+
+// Parallel extraction of a batch of 256 patches of 64 x 64 pixels. Arg: worker threads, caller included
+static void BM_ExtractBatchThreads(benchmark::State& state) {
+    WorkStealingPool pool(static_cast<unsigned>(state.range(0)));
+    std::vector<cv::Mat> patches = makePatches(64, 256, 6);
+    ExtractionSettings settings;
+    settings.levels = 32;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ImageTextureFeatures::extractBatch(patches, settings, pool));
+    }
+    setPixelRate(state, 64.0 * 64.0 * patches.size());
+}
+BENCHMARK(BM_ExtractBatchThreads)->RangeMultiplier(2)->Range(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,70 @@
+#ifndef SYNTHETICWOOD_H
+#define SYNTHETICWOOD_H
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// Kinds of synthetic patches; each defect kind is a distinct class for the classifier benchmarks
+enum class WoodKind {
+    Clear,    // Growth rings and fine grain only
+    Knot,     // Dark ellipse with rings bending around it
+    Split,    // Thin dark crack along the grain
+    Stain     // Low-contrast discoloured blotch
+};
+
+// Generates a reproducible wood-like 8-bit patch: sinusoidal growth rings whose spacing drifts across
+// the board, grain noise along the rings and a kind-specific defect. The same seed gives the same patch.
+// brightness shifts the whole patch, which turns one kind into several separable classes.
+inline cv::Mat makeWoodPatch(int rows, int cols, WoodKind kind, unsigned seed, double brightness = 0.0) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> grain(0.0, 6.0);
+
+    const double pi = 3.14159265358979323846;
+    const double ring_period = 7.0 + 5.0 * uniform(rng);   // Pixels between rings
+    const double ring_tilt = 0.15 * (uniform(rng) - 0.5);  // Rings are nearly parallel to the columns
+    const double base = 150.0 + 30.0 * uniform(rng) + brightness;
+    const double center_row = rows * (0.3 + 0.4 * uniform(rng));
+    const double center_col = cols * (0.3 + 0.4 * uniform(rng));
+    const double radius = 0.18 * std::min(rows, cols) * (1.0 + uniform(rng));
+
+    cv::Mat patch(rows, cols, CV_8UC1);
+    for (int r = 0; r < rows; ++r) {
+        uchar* pixels = patch.ptr<uchar>(r);
+        for (int c = 0; c < cols; ++c) {
+            double dr = (r - center_row) / radius;
+            double dc = (c - center_col) / (0.6 * radius);
+            double knot_distance = std::sqrt(dr * dr + dc * dc);
+
+            double phase = c + ring_tilt * r;
+            if (kind == WoodKind::Knot) {
+                phase += 6.0 * std::exp(-knot_distance * knot_distance);  // Rings bend around the knot
+            }
+            double value = base + 18.0 * std::sin(2.0 * pi * phase / ring_period) + grain(rng);
+
+            switch (kind) {
+            case WoodKind::Knot:
+                if (knot_distance < 1.0) {
+                    value -= 70.0 * (1.0 - knot_distance * knot_distance);
+                }
+                break;
+            case WoodKind::Split:
+                if (std::abs(c - center_col - 0.1 * (r - center_row)) < 1.5) {
+                    value = 35.0 + grain(rng);
+                }
+                break;
+            case WoodKind::Stain:
+                value -= 25.0 * std::exp(-0.5 * knot_distance * knot_distance);
+                break;
+            case WoodKind::Clear:
+                break;
+            }
+            pixels[c] = cv::saturate_cast<uchar>(value);
+        }
+    }
+    return patch;
+}
+
+#endif // SYNTHETICWOOD_H